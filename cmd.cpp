@@ -1,5 +1,7 @@
 #include "cmd.h"
 #include "noise.h"
+#include "hash.h"
+#include "utils.h"
 #include <list>
 #include <array>
 #include <iostream>
@@ -7,11 +9,64 @@
 #include <sstream>
 #include <climits>
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <future>
 
 namespace nti
 {
 	namespace cmd
 	{
+		namespace
+		{
+			// Serialized batches go to a regular file with parallel positioned writes, anywhere else through a sink
+			class DataOutput
+			{
+				std::unique_ptr<IPositionedOutput> positioned_;
+				std::unique_ptr<IOutputSink> sink_;
+				uint64_t offset_ = { 0 };
+			public:
+				DataOutput(const IChannelTesterWriter &writer, const std::string &path) : positioned_(writer.openPositioned(path))
+				{
+					if (!positioned_)
+						sink_ = writer.openSink(path);
+				}
+
+				uint64_t offset() const { return positioned_ ? offset_ : sink_->size(); }
+
+				void write(const IChannelTesterSerialzer &serializer, const std::vector<UserTestInput> &data)
+				{
+					if (positioned_)
+						offset_ = serializer.serializeData(data, *positioned_, offset_);
+					else
+						serializer.serializeData(data, *sink_);
+				}
+
+				void close()
+				{
+					if (positioned_)
+						positioned_->close();
+					else
+						sink_->close();
+				}
+			};
+
+			// a path as one word of a shell command line, whatever it contains
+			std::string shell_quote_(const std::string &path)
+			{
+#ifdef _WIN32
+				return "\"" + path + "\"";
+#else
+				std::string ret = "'";
+				for (auto c : path)
+					if (c == '\'')
+						ret += "'\\''";
+					else
+						ret += c;
+				return ret + "'";
+#endif
+			}
+		}
 
 		void CommandProcessor::opt_check_(const std::string& name) const noexcept(false)
 		{
@@ -79,6 +134,8 @@ namespace nti
 		{
 			constexpr size_t stepcheck_limit = 1;
 			size_t step = 0;
+			if (token == "-") // a lone '-' is a value meaning stdin/stdout
+				return std::make_pair<TokenType, std::string>(TokenType::OPTION_VALUE, std::string(token));
 			auto fsm_step = [&step, &stepcheck_limit, &token]() -> bool
 				{
 					if (token.size() == step)
@@ -183,85 +240,680 @@ namespace nti
 			}
 		}
 
+		LineIndex NTICommandLine::loadIndex_(const std::string& path, bool with_noise_levels, std::string& data) const
+		{
+			LineIndex index;
+			if (loadSidecar_(path, index) && (!with_noise_levels || index.hasNoiseLevels()))
+				return index;
+			// no (usable) sidecar - scan the file itself
+			data = writer_.fromFile(path);
+			index = LineIndex::Scan(data);
+			if (with_noise_levels)
+				for (size_t i = 0; i < index.size(); ++i)
+					index.noise_levels.push_back(parser_.parseInputLine(data.substr(index.offsets[i], index.lengths[i])).noise_level);
+			return index;
+		}
+
+		std::vector<std::string> NTICommandLine::readLines_(const std::string& path, const LineIndex& index, const std::string& data, const std::vector<size_t>& lines) const
+		{
+			std::vector<std::pair<uint64_t, uint64_t>> ranges;
+			for (auto l : lines)
+				ranges.emplace_back(index.offsets[l], index.lengths[l]);
+			if (data.empty())
+				return writer_.fromFile(path, ranges);
+			std::vector<std::string> ret;
+			for (const auto &r : ranges)
+				ret.push_back(data.substr(r.first, r.second));
+			return ret;
+		}
+
+		bool NTICommandLine::loadSidecar_(const std::string& path, LineIndex& index) const
+		{
+			// offsets of a pipe cannot be read again, nor can its sidecar be checked against it
+			auto index_path = path + LineIndex::EXTENSION;
+			uint64_t size = 0, mtime = 0;
+			if (path == NTIChannelTesterWriter::STD_STREAM || !writer_.fileStat(path, size, mtime) || !writer_.exists(index_path))
+				return false;
+			auto sidecar = parser_.parseIndex(writer_.fromFile(index_path));
+			if (!sidecar.describes(size, mtime))
+			{
+				std::cerr << "Ignoring '" << index_path << "': it was written for another version of '" << path << "'" << std::endl;
+				return false;
+			}
+			index = std::move(sidecar);
+			return true;
+		}
+
+		void NTICommandLine::writeIndex_(const std::string& path, LineIndex index) const
+		{
+			if (path == NTIChannelTesterWriter::STD_STREAM)
+				throw std::runtime_error("[writeIndex_] Index sidecar cannot be written for stdout");
+			// the data is complete by now, its size and time tell a later run whether the index still fits
+			if (!writer_.fileStat(path, index.data_size, index.data_mtime))
+				index.data_size = index.data_mtime = 0;
+			writer_.toFile(path + LineIndex::EXTENSION, serializer_.serializeIndex(index));
+		}
+
+		std::ostream& NTICommandLine::status_(const std::string& output_path) const
+		{
+			return output_path == NTIChannelTesterWriter::STD_STREAM ? std::cerr : std::cout;
+		}
+
+		void NTICommandLine::checkSingleStdin_(const std::vector<std::string>& input_paths) const
+		{
+			if (std::count(input_paths.begin(), input_paths.end(), NTIChannelTesterWriter::STD_STREAM) > 1)
+				throw std::runtime_error("Only one input can be read from stdin ('" + NTIChannelTesterWriter::STD_STREAM + "')");
+		}
+
 		void NTICommandLine::doAddNoise_() const
 		{
-			// Noises encoded data - noise, source data
-			auto encoded_data = writer_.fromFile(getOpt<std::string>(Values::INPUT_ENCODED_DATA));
-			auto input_data = writer_.fromFile(getOpt<std::string>(Values::INOUT_SOURCE_DATA));
+			// Noises encoded data - noise, source data. Streams both inputs batch by batch, so it works in a pipeline.
+			auto encoded_path = getOpt<std::string>(Values::INPUT_ENCODED_DATA), source_path = getOpt<std::string>(Values::INOUT_SOURCE_DATA),
+				noised_path = getOpt<std::string>(Values::INOUT_NOISED_DATA);
+			checkSingleStdin_({ encoded_path, source_path });
+			bool write_index = getFlagVal(Flags::OPT_WRITE_INDEX);
+			if (write_index && noised_path == NTIChannelTesterWriter::STD_STREAM)
+				throw std::runtime_error("Index sidecar cannot be written for stdout");
+
+			// repeated variants need independent streams, so they are always counter-based
+			size_t repeat = isOptSet(Values::PARAM_REPEAT) ? size_t(getOpt<int>(Values::PARAM_REPEAT)) : 1;
+			// biased noise comes with the likelihood ratio of every test, written alongside
+			bool biased = isOptSet(Values::PARAM_BIAS);
+			if (biased && repeat > 1)
+				throw std::runtime_error("[Send()] -" + Values::PARAM_BIAS + " cannot be combined with -" + Values::PARAM_REPEAT);
+			std::unique_ptr<IOutputSink> weights_out(biased ? writer_.openSink(getOpt<std::string>(Values::INOUT_WEIGHTS)) : nullptr);
+			std::vector<NoiseLikelihood> likelihoods;
+			uint64_t seed = isOptSet(Values::PARAM_NOISE_SEED) ? uint64_t(getOpt<int>(Values::PARAM_NOISE_SEED)) :
+				(uint64_t(std::random_device()()) << 32) ^ std::random_device()();
 
-			auto input = parser_.parseInput(input_data);
-			auto encoded = parser_.parseCoderOutput(encoded_data);
-			if (input.size() != encoded.size())
-				throw std::runtime_error("[Send()] Data mismatch: number of lines in encoded data (" + std::to_string(encoded.size()) + ") not equal to lines in source data ("+std::to_string(input.size())+")");
+			LineReader encoded_in(writer_.openInput(encoded_path)), source_in(writer_.openInput(source_path));
+			DataOutput out(writer_, noised_path);
+			LineIndex index;
+			size_t num_encoded = 0, num_source = 0;
+			std::string line;
+			std::vector<UserTestInput> input;
+			std::vector<std::string> encoded;
+			while (true)
+			{
+				input.clear(); encoded.clear();
+				bool has_source = true;
+				// every encoding is noised 'repeat' times, the batch is bounded by those bytes too
+				size_t batch_bytes = 0;
+				while (input.size() < STREAM_BATCH_LINES && batch_bytes < STREAM_BATCH_BYTES && (has_source = source_in.next(line)))
+				{
+					input.push_back(parser_.parseInputLine(line));
+					if (!encoded_in.next(line))
+						break;
+					batch_bytes += input.back().input.size() + line.size() * (repeat + 1);
+					encoded.push_back(std::move(line));
+				}
+				// past the last source line, an encoded line left over is a mismatch as well
+				if (!has_source && encoded_in.next(line))
+					encoded.push_back(std::move(line));
+				num_source += input.size();
+				num_encoded += encoded.size();
+				if (input.size() != encoded.size())
+				{
+					// count what is left to report the mismatch properly
+					while (encoded_in.next(line)) ++num_encoded;
+					while (source_in.next(line)) ++num_source;
+					throw std::runtime_error("[Send()] Data mismatch: number of lines in encoded data (" + std::to_string(num_encoded) + ") not equal to lines in source data ("+std::to_string(num_source)+")");
+				}
 
-			auto out = tester_.generateNoisedInputs(input, encoded);
-			auto noised_serialized = serializer_.serializeData(out);
-			writer_.toFile(getOpt<std::string>(Values::INOUT_NOISED_DATA), noised_serialized);
+				// a seed makes the noise of every test reproducible, whatever encoding it is applied to
+				auto noised = biased ? tester_.generateBiasedInputs(input, encoded, getOpt<float>(Values::PARAM_BIAS), seed, num_source - input.size(), likelihoods) :
+					repeat > 1 ? tester_.generateNoisedRepeats(input, encoded, repeat, seed, num_source - input.size()) :
+					isOptSet(Values::PARAM_NOISE_SEED) ? tester_.generateNoisedInputs(input, encoded, seed, num_source - input.size()) :
+					tester_.generateNoisedInputs(input, encoded);
+				if (write_index)
+					index.append(serializer_.indexData(noised, out.offset()));
+				out.write(serializer_, noised);
+				if (biased)
+					serializer_.serializeLikelihoods(likelihoods, *weights_out);
+				if (!has_source)
+					break;
+			}
+			out.close();
+			if (biased)
+				weights_out->close();
+			if (write_index)
+				writeIndex_(noised_path, std::move(index));
 
-			std::cout << out.size() << " noised inputs have successfully generated!";
+			status_(noised_path) << num_source * repeat << " noised inputs have successfully generated!";
 
 		}
 
 		void NTICommandLine::doCheckDecode_() const
 		{
-			// Noises encoded data - noise, source data
-			auto noised_data = writer_.fromFile(getOpt<std::string>(Values::INOUT_NOISED_DATA));
-			auto source_data = writer_.fromFile(getOpt<std::string>(Values::INOUT_SOURCE_DATA));
-			auto decoded_data = writer_.fromFile(getOpt<std::string>(Values::INPUT_DECODED_DATA));
-			auto encoded_data = writer_.fromFile(getOpt<std::string>(Values::INPUT_ENCODED_DATA));
+			std::vector<UserTestInput> source, noised;
+			std::vector<std::string> decoded, encoded;
 
-			auto source = parser_.parseInput(source_data);
-			auto decoded = parser_.parseCoderOutput(decoded_data);
-			auto noised = parser_.parseInput(noised_data);
-			auto encoded = parser_.parseCoderOutput(encoded_data);
-			
-			std::vector<UserTestInput> out;
+			auto source_path = getOpt<std::string>(Values::INOUT_SOURCE_DATA), noised_path = getOpt<std::string>(Values::INOUT_NOISED_DATA),
+				decoded_path = getOpt<std::string>(Values::INPUT_DECODED_DATA), encoded_path = getOpt<std::string>(Values::INPUT_ENCODED_DATA);
+			checkSingleStdin_({ noised_path, source_path, decoded_path, encoded_path });
+			configureTester_(tester_);
+			// the whole corpus is streamed, only a selection is loaded
+			if (!isOptSet(Values::PARAM_SELECT_TESTS) && !isOptSet(Values::PARAM_SELECT_NOISE))
+			{
+				doCheckDecodeStream_();
+				return;
+			}
+			if (getFlagVal(Flags::OPT_FAIL_FAST))
+				throw std::runtime_error("[Decode()] -" + Flags::OPT_FAIL_FAST + " cannot be combined with test selection");
+			if (isOptSet(Values::PARAM_REPEAT) || isOptSet(Values::INOUT_WEIGHTS))
+				throw std::runtime_error("[Decode()] -" + Values::PARAM_REPEAT + " and -" + Values::INOUT_WEIGHTS + " cannot be combined with test selection");
 
-			if (source.size() != noised.size() || source.size() != decoded.size() || source.size() != encoded.size() )
+			// load only selected tests, seeking through sidecar indexes when they are present
+			std::vector<size_t> tests;
+			std::vector<float> levels;
+			if (isOptSet(Values::PARAM_SELECT_TESTS))
+				for (auto t : getOpt<std::vector<int>>(Values::PARAM_SELECT_TESTS))
+					tests.push_back(size_t(t - 1));
+			if (isOptSet(Values::PARAM_SELECT_NOISE))
+				levels = getOpt<std::vector<float>>(Values::PARAM_SELECT_NOISE);
+
+			std::string source_data, noised_data, decoded_data, encoded_data;
+			auto load_index = [this](const std::string &path, bool with_noise_levels, std::string &data)
+			{
+				return std::async(std::launch::async, [this, &path, with_noise_levels, &data]() { return loadIndex_(path, with_noise_levels, data); });
+			};
+			auto source_index_f = load_index(source_path, true, source_data), noised_index_f = load_index(noised_path, false, noised_data),
+				decoded_index_f = load_index(decoded_path, false, decoded_data), encoded_index_f = load_index(encoded_path, false, encoded_data);
+			auto source_index = source_index_f.get(), noised_index = noised_index_f.get(), 
+				decoded_index = decoded_index_f.get(), encoded_index = encoded_index_f.get();
+			if (source_index.size() != noised_index.size() || source_index.size() != decoded_index.size() || source_index.size() != encoded_index.size())
 				throw std::runtime_error("[Decode()] Data mismatch: numbers of lines in files are in consistent. \
-										  Decoded: "+ std::to_string(decoded.size()) + 
-											", noised: "+ std::to_string(noised.size())+
-											", source: "+std::to_string(source.size())+ 
-											", encoded: "+std::to_string(encoded.size()));
+										  Decoded: " + std::to_string(decoded_index.size()) +
+										  ", noised: " + std::to_string(noised_index.size()) +
+										  ", source: " + std::to_string(source_index.size()) +
+										  ", encoded: " + std::to_string(encoded_index.size()));
 
-			for (size_t i = 0, s = source.size(); i<s; ++i)
+			auto test_ids = source_index.select(tests, levels);
+			auto read_lines = [this, &test_ids](const std::string &path, const LineIndex &index, const std::string &data)
 			{
-				auto token = tester_.setAlgoEncodeResponse(source[i].input, encoded[i], {});
-				tester_.setAlgoDecodeResponse(token, decoded[i]);
-				
+				return std::async(std::launch::async, [this, &path, &index, &data, &test_ids]() { return readLines_(path, index, data, test_ids); });
+			};
+			auto source_f = read_lines(source_path, source_index, source_data), noised_f = read_lines(noised_path, noised_index, noised_data),
+				decoded_f = read_lines(decoded_path, decoded_index, decoded_data), encoded_f = read_lines(encoded_path, encoded_index, encoded_data);
+			for (auto &l : source_f.get())
+				source.push_back(parser_.parseInputLine(l));
+			for (auto &l : noised_f.get())
+				noised.push_back(parser_.parseInputLine(l));
+			decoded = decoded_f.get();
+			encoded = encoded_f.get();
+
+			// verified in parallel shards
+			tester_.setAlgoResponses(source, noised, encoded, decoded);
+			auto rep = tester_.generateReport();
+			rep.test_ids = std::move(test_ids);
+
+			auto out = writer_.openSink(getOpt<std::string>(Values::OUTPUT_REPORT));
+			serializer_.serializeReport(rep, source, noised, decoded, *out, reportLayout_());
+			out->close();
+			writeHeatmap_(rep);
+			status_(getOpt<std::string>(Values::OUTPUT_REPORT)) << "Test report has successfully generated!";
+
+		}
+
+		void NTICommandLine::configureTester_(IChannelTester& tester) const
+		{
+			if (isOptSet(Values::PARAM_RETAIN_FAILED) || isOptSet(Values::PARAM_RETAIN_POLICY))
+				tester.setFailureRetention(
+					isOptSet(Values::PARAM_RETAIN_POLICY) ? FailureRetention::ParsePolicy(getOpt<std::string>(Values::PARAM_RETAIN_POLICY)) : FailureRetention::Policy::FIRST,
+					isOptSet(Values::PARAM_RETAIN_FAILED) ? size_t(getOpt<int>(Values::PARAM_RETAIN_FAILED)) : FailureRetention::DEFAULT_LIMIT);
+			if (isOptSet(Values::PARAM_CODEWORD_LENGTH))
+				tester.setCodewordLength(size_t(getOpt<int>(Values::PARAM_CODEWORD_LENGTH)));
+			if (isOptSet(Values::PARAM_EDIT_DISTANCE))
+				tester.setEditDistance(size_t(getOpt<int>(Values::PARAM_EDIT_DISTANCE)));
+		}
+
+		void NTICommandLine::doCompare_() const
+		{
+			auto source_path = getOpt<std::string>(Values::INOUT_SOURCE_DATA), report_path = getOpt<std::string>(Values::OUTPUT_REPORT);
+			auto noised_a_path = getOpt<std::string>(Values::INOUT_NOISED_DATA), encoded_a_path = getOpt<std::string>(Values::INPUT_ENCODED_DATA),
+				decoded_a_path = getOpt<std::string>(Values::INPUT_DECODED_DATA);
+			auto noised_b_path = getOpt<std::string>(Values::INPUT_NOISED_DATA_B), encoded_b_path = getOpt<std::string>(Values::INPUT_ENCODED_DATA_B),
+				decoded_b_path = getOpt<std::string>(Values::INPUT_DECODED_DATA_B);
+			checkSingleStdin_({ source_path, noised_a_path, encoded_a_path, decoded_a_path, noised_b_path, encoded_b_path, decoded_b_path });
+
+			NTIChannelTester tester_a, tester_b;
+			for (auto t : { &tester_a, &tester_b })
+			{
+				configureTester_(*t);
+				// the comparison lists no failed tests
+				t->setFailureRetention(FailureRetention::Policy::FIRST, 0);
 			}
-			auto rep = tester_.generateReport(decoded);
+			LineReader source_in(writer_.openInput(source_path)),
+				noised_a_in(writer_.openInput(noised_a_path)), encoded_a_in(writer_.openInput(encoded_a_path)), decoded_a_in(writer_.openInput(decoded_a_path)),
+				noised_b_in(writer_.openInput(noised_b_path)), encoded_b_in(writer_.openInput(encoded_b_path)), decoded_b_in(writer_.openInput(decoded_b_path));
+			std::vector<UserTestInput> source, noised_a, noised_b;
+			std::vector<std::string> encoded_a, decoded_a, encoded_b, decoded_b;
+			PairedStatistics paired;
+			size_t num_checked = 0;
+			std::string line;
+			size_t batch_bytes = 0;
+			auto read_line = [&line, &batch_bytes](LineReader &in, std::vector<std::string> &to) { if (in.next(line)) { batch_bytes += line.size(); to.push_back(std::move(line)); } };
+			auto read_input = [this, &line, &batch_bytes](LineReader &in, std::vector<UserTestInput> &to) { if (in.next(line)) { batch_bytes += line.size(); to.push_back(parser_.parseInputLine(line)); } };
+			bool has_more = true;
+			while (has_more)
+			{
+				source.clear(); noised_a.clear(); noised_b.clear();
+				encoded_a.clear(); decoded_a.clear(); encoded_b.clear(); decoded_b.clear();
+				batch_bytes = 0;
+				while (source.size() < STREAM_BATCH_LINES && batch_bytes < STREAM_BATCH_BYTES && (has_more = source_in.next(line)))
+				{
+					batch_bytes += line.size();
+					source.push_back(parser_.parseInputLine(line));
+					read_input(noised_a_in, noised_a); read_line(encoded_a_in, encoded_a); read_line(decoded_a_in, decoded_a);
+					read_input(noised_b_in, noised_b); read_line(encoded_b_in, encoded_b); read_line(decoded_b_in, decoded_b);
+				}
+				const size_t count = source.size();
+				for (auto size : { noised_a.size(), encoded_a.size(), decoded_a.size(), noised_b.size(), encoded_b.size(), decoded_b.size() })
+					if (size != count)
+						throw std::runtime_error("[Compare()] Data mismatch: an input ends after " + std::to_string(num_checked + size) +
+							" lines while the source has more");
+				if (!has_more)
+					for (auto in : { &noised_a_in, &encoded_a_in, &decoded_a_in, &noised_b_in, &encoded_b_in, &decoded_b_in })
+						if (in->next(line))
+							throw std::runtime_error("[Compare()] Data mismatch: an input has more lines than the source (" + std::to_string(num_checked + count) + ")");
 
-			writer_.toFile(getOpt<std::string>(Values::OUTPUT_REPORT), serializer_.serializeReport(rep, source, noised, decoded));
-			std::cout << "Test report has successfully generated!";
+				tester_a.streamAlgoResponses(source, noised_a, encoded_a, decoded_a);
+				tester_b.streamAlgoResponses(source, noised_b, encoded_b, decoded_b);
+				// both testers measured the batch in the same order, their verdicts are paired test by test
+				const auto &ma = tester_a.lastBatch(), &mb = tester_b.lastBatch();
+				for (size_t i = 0; i < count; ++i)
+				{
+					double bits = 8.0 * source[i].input.size();
+					paired.add(source[i].noise_level, ma[i].mismatches == 0, mb[i].mismatches == 0,
+						bits ? ma[i].residual_bits / bits : 0, bits ? mb[i].residual_bits / bits : 0);
+				}
+				num_checked += count;
+			}
 
+			auto out = writer_.openSink(report_path);
+			serializer_.serializeComparison(tester_a.generateReport(), tester_b.generateReport(), paired, *out);
+			out->close();
+			status_(report_path) << "Comparison report of " << num_checked << " tests has successfully generated!";
 		}
 
-		
-		
+		void NTICommandLine::doCheckDecodeStream_() const
+		{
+			auto source_path = getOpt<std::string>(Values::INOUT_SOURCE_DATA), noised_path = getOpt<std::string>(Values::INOUT_NOISED_DATA),
+				decoded_path = getOpt<std::string>(Values::INPUT_DECODED_DATA), encoded_path = getOpt<std::string>(Values::INPUT_ENCODED_DATA);
+			bool fail_fast = getFlagVal(Flags::OPT_FAIL_FAST);
+			// with repetition every source and encoded line stands for 'repeat' consecutive noised and decoded lines
+			const size_t repeat = isOptSet(Values::PARAM_REPEAT) ? size_t(getOpt<int>(Values::PARAM_REPEAT)) : 1;
+			std::unique_ptr<RepeatStatistics> repeats(isOptSet(Values::PARAM_REPEAT) ? new RepeatStatistics(repeat, NTIChannelTesterSerializer::REPORT_WORST_LINES) : nullptr);
+			// likelihood ratios of a biased run, one per noised line
+			std::unique_ptr<LineReader> weights_in(isOptSet(Values::INOUT_WEIGHTS) ? new LineReader(writer_.openInput(getOpt<std::string>(Values::INOUT_WEIGHTS))) : nullptr);
+			ImportanceStatistics importance;
+			std::vector<NoiseLikelihood> likelihoods;
+			// with a fingerprinted source index decoded lines are checked against the fingerprints,
+			// and only the sources of mismatching ones are read
+			// the sidecar has to fit the source file, stale fingerprints would pass tests against another corpus
+			LineIndex source_index;
+			if (loadSidecar_(source_path, source_index) && (!source_index.hasFingerprints() || !source_index.hasNoiseLevels()))
+				source_index = LineIndex();
+			const bool fingerprinted = source_index.hasFingerprints();
+			// without the total only a test with too many errors can decide the verdict early
+			size_t total = fail_fast ? (fingerprinted ? source_index.size() : countTests_(source_path)) * repeat : 0;
+
+			std::unique_ptr<LineReader> source_in(fingerprinted ? nullptr : new LineReader(writer_.openInput(source_path)));
+			LineReader noised_in(writer_.openInput(noised_path)), decoded_in(writer_.openInput(decoded_path)), encoded_in(writer_.openInput(encoded_path));
+			size_t num_checked = 0;
+			std::string line, encoded_line;
+			// a fingerprinted source yields placeholders, their inputs are filled in only when they are needed
+			auto next_source = [&](size_t batch_size) -> bool
+			{
+				if (fingerprinted)
+				{
+					auto t = (num_checked + batch_size) / repeat;
+					if (t >= source_index.size())
+						return false;
+					line = IChannelTester::MODE_ENCODE_STR;
+					return true;
+				}
+				return source_in->next(line);
+			};
+			// only the current batch is resident, the tester keeps statistics and a sample of failures
+			std::vector<UserTestInput> source, noised;
+			std::vector<std::string> decoded, encoded;
+			SourceFingerprints fingerprints;
+			auto decided = TestReport::FailReason::NONE;
+			bool has_more = true;
+			while (has_more && decided == TestReport::FailReason::NONE)
+			{
+				source.clear(); noised.clear(); decoded.clear(); encoded.clear();
+				// the variants of a line are never split between batches, so a batch may run over its bytes by one group
+				size_t batch_bytes = 0;
+				while (source.size() < STREAM_BATCH_LINES && batch_bytes < STREAM_BATCH_BYTES && (has_more = next_source(source.size())))
+				{
+					auto input = fingerprinted ? UserTestInput{ line, source_index.noise_levels[(num_checked + source.size()) / repeat], std::string() } : parser_.parseInputLine(line);
+					bool has_encoded = encoded_in.next(encoded_line);
+					for (size_t v = 0; v < repeat; ++v)
+					{
+						source.push_back(input);
+						batch_bytes += input.input.size() + (has_encoded ? encoded_line.size() : 0);
+						if (noised_in.next(line))
+						{
+							batch_bytes += line.size();
+							noised.push_back(parser_.parseInputLine(line));
+						}
+						if (decoded_in.next(line))
+						{
+							batch_bytes += line.size();
+							decoded.push_back(std::move(line));
+						}
+						if (has_encoded)
+							encoded.push_back(encoded_line);
+					}
+				}
+				if (source.size() != noised.size() || source.size() != decoded.size() || source.size() != encoded.size() ||
+					(!has_more && (noised_in.next(line) || decoded_in.next(line) || encoded_in.next(line))))
+				{
+					// count what is left to report the mismatch properly, sources and encodings in lines of their own
+					size_t num_source = num_checked + source.size(), num_noised = num_checked + noised.size(),
+						num_decoded = num_checked + decoded.size(), num_encoded = (num_checked + encoded.size()) / repeat;
+					while (next_source(num_source - num_checked)) num_source += repeat;
+					while (noised_in.next(line)) ++num_noised;
+					while (decoded_in.next(line)) ++num_decoded;
+					while (encoded_in.next(line)) ++num_encoded;
+					throw std::runtime_error("[Decode()] Data mismatch: numbers of lines in files are in consistent. \
+											  Decoded: " + std::to_string(num_decoded) +
+											  ", noised: " + std::to_string(num_noised) +
+											  ", source: " + std::to_string(num_source / repeat) +
+											  ", encoded: " + std::to_string(num_encoded) +
+											  (repeat > 1 ? ", variants per line: " + std::to_string(repeat) : std::string()));
+				}
+
+				if (fingerprinted)
+				{
+					// decoded lines are hashed in parallel, sources of those which differ are read by their offsets
+					const size_t count = source.size();
+					fingerprints.hashes.resize(count);
+					for (size_t i = 0; i < count; ++i)
+						fingerprints.hashes[i] = source_index.fingerprints[(num_checked + i) / repeat];
+					fingerprints.matched.assign(count, 0);
+					parallel_for(count, [&](size_t, size_t begin, size_t end)
+					{
+						for (size_t i = begin; i < end; ++i)
+							fingerprints.matched[i] = hash64(decoded[i]) == fingerprints.hashes[i];
+					});
+					std::vector<size_t> lines;
+					for (size_t i = 0; i < count; ++i)
+						if (!fingerprints.matched[i] && (lines.empty() || lines.back() != (num_checked + i) / repeat))
+							lines.push_back((num_checked + i) / repeat);
+					if (!lines.empty())
+					{
+						auto read = readLines_(source_path, source_index, std::string(), lines);
+						for (size_t l = 0; l < lines.size(); ++l)
+						{
+							auto input = parser_.parseInputLine(read[l]);
+							for (size_t v = 0; v < repeat; ++v)
+								if (lines[l] * repeat + v >= num_checked && lines[l] * repeat + v < num_checked + count)
+									source[lines[l] * repeat + v - num_checked] = input;
+						}
+					}
+				}
+				if (weights_in)
+				{
+					likelihoods.clear();
+					while (likelihoods.size() < source.size() && weights_in->next(line))
+						likelihoods.push_back(parser_.parseLikelihoodLine(line));
+					if (likelihoods.size() != source.size() || (!has_more && weights_in->next(line)))
+						throw std::runtime_error("[Decode()] Data mismatch: number of lines in '" + getOpt<std::string>(Values::INOUT_WEIGHTS) +
+							"' differs from that of noised data");
+				}
+				tester_.streamAlgoResponses(source, noised, encoded, decoded, fingerprinted ? &fingerprints : nullptr);
+				if (weights_in)
+				{
+					const auto &measured = tester_.lastBatch();
+					for (size_t i = 0; i < source.size(); ++i)
+						importance.add(source[i].noise_level, measured[i].mismatches != 0, likelihoods[i].log_ratio);
+				}
+				if (repeats)
+				{
+					const auto &measured = tester_.lastBatch();
+					for (size_t i = 0; i < source.size(); ++i)
+						repeats->add((num_checked + i) / repeat, source[i].noise_level, measured[i].mismatches == 0);
+				}
+				num_checked += source.size();
+				if (fail_fast)
+					decided = tester_.decidedFailure(total);
+			}
+
+			auto rep = tester_.generateReport();
+			// the remaining tests could only have changed the reason, not the verdict
+			if (decided != TestReport::FailReason::NONE && has_more && next_source(0))
+			{
+				rep.has_passed = false;
+				rep.fail_reason = decided;
+				rep.is_partial = true;
+				rep.num_total_tests = total;
+			}
+
+			auto out = writer_.openSink(getOpt<std::string>(Values::OUTPUT_REPORT));
+			serializer_.serializeReport(rep, {}, {}, {}, *out, reportLayout_());
+			if (repeats)
+				serializer_.serializeRepeats(*repeats, *out);
+			if (weights_in)
+				serializer_.serializeImportance(importance, *out);
+			out->close();
+			writeHeatmap_(rep);
+			status_(getOpt<std::string>(Values::OUTPUT_REPORT)) << "Test report has successfully generated!"
+				<< (rep.is_partial ? " Stopped early after " + std::to_string(num_checked) + " tests." : std::string());
+		}
+
+		std::vector<std::string> NTICommandLine::runCodec_(const std::string& command, const std::string& in_path, const std::string& out_path,
+			size_t num_lines) const
+		{
+			std::string cmd = command;
+			for (const auto &p : { std::make_pair(std::string("{in}"), shell_quote_(in_path)), std::make_pair(std::string("{out}"), shell_quote_(out_path)) })
+				for (size_t pos = cmd.find(p.first); pos != std::string::npos; pos = cmd.find(p.first, pos + p.second.size()))
+					cmd.replace(pos, p.first.size(), p.second);
+			std::cout.flush();
+			if (std::system(cmd.c_str()) != 0)
+				throw std::runtime_error("[Codec()] Command failed: " + cmd);
+
+			LineReader in(writer_.openInput(out_path));
+			std::vector<std::string> ret;
+			std::string line;
+			while (in.next(line))
+				ret.push_back(std::move(line));
+			if (ret.size() != num_lines)
+				throw std::runtime_error("[Codec()] Command wrote " + std::to_string(ret.size()) + " lines for " + std::to_string(num_lines) + " inputs: " + cmd);
+			return ret;
+		}
+
+		void NTICommandLine::doAdaptive_() const
+		{
+			// the files of the usual pipeline hold the batch in flight
+			auto source_path = getOpt<std::string>(Values::INOUT_SOURCE_DATA), encoded_path = getOpt<std::string>(Values::INPUT_ENCODED_DATA),
+				noised_path = getOpt<std::string>(Values::INOUT_NOISED_DATA), decoded_path = getOpt<std::string>(Values::INPUT_DECODED_DATA),
+				report_path = getOpt<std::string>(Values::OUTPUT_REPORT);
+			for (const auto &path : { source_path, encoded_path, noised_path, decoded_path })
+				if (path == NTIChannelTesterWriter::STD_STREAM)
+					throw std::runtime_error("[Adaptive()] Batches are passed to the codec through files, not '" + path + "'");
+			auto encoder = getOpt<std::string>(Values::PARAM_ENCODER), decoder = getOpt<std::string>(Values::PARAM_DECODER);
+			size_t max_length = size_t(getOpt<int>(Values::PARAM_SOURCE_MAXSIZE)), batch = size_t(getOpt<int>(Values::PARAM_NUM_SOURCES));
+			SequentialEstimator estimator(getOpt<std::vector<float>>(Values::PARAM_NOISE_LEVELS), NTIChannelTester::THRESHOLD_SUCCESS_RATE,
+				isOptSet(Values::PARAM_CI_WIDTH) ? getOpt<float>(Values::PARAM_CI_WIDTH) : 0.02,
+				isOptSet(Values::PARAM_MAX_TESTS) ? size_t(getOpt<int>(Values::PARAM_MAX_TESTS)) : 100000);
+			configureTester_(tester_);
+
+			size_t total = 0, rounds = 0;
+			for (auto open = estimator.open(); !open.empty(); open = estimator.open(), ++rounds)
+			{
+				// every level still open gets a batch, all of them go through the codec at once
+				std::vector<UserTestInput> source;
+				for (auto level : open)
+				{
+					auto vals = tester_.generateInputs(batch, level, max_length);
+					source.insert(source.end(), vals.begin(), vals.end());
+				}
+				writer_.toFile(source_path, serializer_.serializeData(source));
+				auto encoded = runCodec_(encoder, source_path, encoded_path, source.size());
+				auto noised = isOptSet(Values::PARAM_NOISE_SEED) ?
+					tester_.generateNoisedInputs(source, encoded, uint64_t(getOpt<int>(Values::PARAM_NOISE_SEED)), total) :
+					tester_.generateNoisedInputs(source, encoded);
+				writer_.toFile(noised_path, serializer_.serializeData(noised));
+				auto decoded = runCodec_(decoder, noised_path, decoded_path, noised.size());
+
+				tester_.streamAlgoResponses(source, noised, encoded, decoded);
+				const auto &measured = tester_.lastBatch();
+				for (size_t i = 0; i < source.size(); ++i)
+					estimator.add(source[i].noise_level, measured[i].mismatches == 0);
+				// levels are settled only on whole rounds
+				estimator.decide();
+				total += source.size();
+			}
+
+			auto out = writer_.openSink(report_path);
+			serializer_.serializeReport(tester_.generateReport(), {}, {}, {}, *out, reportLayout_());
+			serializer_.serializeEstimates(estimator, *out);
+			out->close();
+			status_(report_path) << "Test report of " << total << " tests in " << rounds << " rounds has successfully generated!";
+		}
+
+		void NTICommandLine::doSweep_() const
+		{
+			auto source_path = getOpt<std::string>(Values::INOUT_SOURCE_DATA), encoded_path = getOpt<std::string>(Values::INPUT_ENCODED_DATA),
+				noised_path = getOpt<std::string>(Values::INOUT_NOISED_DATA), decoded_path = getOpt<std::string>(Values::INPUT_DECODED_DATA),
+				report_path = getOpt<std::string>(Values::OUTPUT_REPORT);
+			for (const auto &path : { source_path, encoded_path, noised_path, decoded_path })
+				if (path == NTIChannelTesterWriter::STD_STREAM)
+					throw std::runtime_error("[Sweep()] Batches are passed to the codec through files, not '" + path + "'");
+			auto encoder = getOpt<std::string>(Values::PARAM_ENCODER), decoder = getOpt<std::string>(Values::PARAM_DECODER);
+			size_t max_length = size_t(getOpt<int>(Values::PARAM_SOURCE_MAXSIZE)), batch = size_t(getOpt<int>(Values::PARAM_NUM_SOURCES));
+			auto range = getOpt<std::vector<float>>(Values::PARAM_SWEEP_RANGE);
+			ThresholdSweep sweep(range[0], range[1], isOptSet(Values::PARAM_PRECISION) ? getOpt<float>(Values::PARAM_PRECISION) : 0.001f,
+				isOptSet(Values::PARAM_CANDIDATES) ? size_t(getOpt<int>(Values::PARAM_CANDIDATES)) : 3, NTIChannelTester::THRESHOLD_SUCCESS_RATE);
+			uint64_t seed = isOptSet(Values::PARAM_NOISE_SEED) ? uint64_t(getOpt<int>(Values::PARAM_NOISE_SEED)) :
+				(uint64_t(std::random_device()()) << 32) ^ std::random_device()();
+			bool encode_once = getFlagVal(Flags::OPT_ENCODE_ONCE);
+			configureTester_(tester_);
+
+			// the same sources at every level, and source 'j' is noised by stream 'j' whatever the level: the flips
+			// at a level are a subset of those at a higher one, so the levels of a round differ only by the noise
+			auto texts = tester_.generateInputs(batch, range[1], max_length);
+			std::vector<std::string> encoded_once;
+			if (encode_once)
+			{
+				writer_.toFile(source_path, serializer_.serializeData(texts));
+				encoded_once = runCodec_(encoder, source_path, encoded_path, texts.size());
+			}
+			size_t total = 0;
+			for (auto levels = sweep.next(); !levels.empty(); levels = sweep.next())
+			{
+				std::vector<UserTestInput> source, noised;
+				std::vector<std::string> encoded;
+				for (auto level : levels)
+					for (const auto &t : texts)
+						source.push_back(UserTestInput{ t.mode, level, t.input });
+				if (encode_once)
+					for (size_t l = 0; l < levels.size(); ++l)
+						encoded.insert(encoded.end(), encoded_once.begin(), encoded_once.end());
+				else
+				{
+					writer_.toFile(source_path, serializer_.serializeData(source));
+					encoded = runCodec_(encoder, source_path, encoded_path, source.size());
+				}
+				for (size_t l = 0; l < levels.size(); ++l)
+				{
+					auto vals = tester_.generateNoisedInputs(std::vector<UserTestInput>(source.begin() + l * batch, source.begin() + (l + 1) * batch),
+						std::vector<std::string>(encoded.begin() + l * batch, encoded.begin() + (l + 1) * batch), seed, 0);
+					noised.insert(noised.end(), vals.begin(), vals.end());
+				}
+				writer_.toFile(noised_path, serializer_.serializeData(noised));
+				auto decoded = runCodec_(decoder, noised_path, decoded_path, noised.size());
+
+				tester_.streamAlgoResponses(source, noised, encoded, decoded);
+				const auto &measured = tester_.lastBatch();
+				std::vector<size_t> tests(levels.size(), batch), successes(levels.size(), 0);
+				for (size_t i = 0; i < measured.size(); ++i)
+					successes[i / batch] += measured[i].mismatches == 0;
+				sweep.record(levels, tests, successes);
+				total += source.size();
+			}
+
+			auto out = writer_.openSink(report_path);
+			serializer_.serializeReport(tester_.generateReport(), {}, {}, {}, *out, reportLayout_());
+			serializer_.serializeSweep(sweep, *out);
+			out->close();
+			status_(report_path) << "Test report of " << total << " tests in " << sweep.rounds().size() << " rounds has successfully generated!";
+		}
+
+		ReportLayout NTICommandLine::reportLayout_() const
+		{
+			ReportLayout layout;
+			if (isOptSet(Values::PARAM_REPORT_CONTEXT))
+				layout.context = size_t(getOpt<int>(Values::PARAM_REPORT_CONTEXT));
+			layout.summary = getFlagVal(Flags::OPT_REPORT_SUMMARY);
+			return layout;
+		}
+
+		void NTICommandLine::writeHeatmap_(const TestReport& report) const
+		{
+			if (!isOptSet(Values::OUTPUT_HEATMAP))
+				return;
+			auto out = writer_.openSink(getOpt<std::string>(Values::OUTPUT_HEATMAP));
+			serializer_.serializeHeatmap(report.heatmap, *out);
+			out->close();
+		}
+
+		size_t NTICommandLine::countTests_(const std::string& path) const
+		{
+			// a stream is read once only, it is never drained just to be counted
+			uint64_t size = 0, mtime = 0;
+			if (path == NTIChannelTesterWriter::STD_STREAM || !writer_.fileStat(path, size, mtime))
+				return 0;
+			LineIndex index;
+			if (loadSidecar_(path, index))
+				return index.size();
+			LineReader in(writer_.openInput(path));
+			std::string line;
+			size_t ret = 0;
+			while (in.next(line))
+				++ret;
+			return ret;
+		}
 
 		void NTICommandLine::doGenerateSource_() const
 		{
 			size_t number_tests = this->getOpt<int>(Values::PARAM_NUM_SOURCES);
 			size_t max_length = this->getOpt<int>(Values::PARAM_SOURCE_MAXSIZE);
 			auto noise_levels = this->getOpt<std::vector<float>>(Values::PARAM_NOISE_LEVELS);
-			std::vector<UserTestInput> vals;
-			
-			
+			auto source_path = getOpt<std::string>(Values::INOUT_SOURCE_DATA);
+			bool write_index = getFlagVal(Flags::OPT_WRITE_INDEX);
+			if (write_index && source_path == NTIChannelTesterWriter::STD_STREAM)
+				throw std::runtime_error("Index sidecar cannot be written for stdout");
 
+			// generate batch by batch, serializing each one while the previous is being written
+			DataOutput out(writer_, source_path);
+			LineIndex index;
+			size_t total = 0;
+			// lines may be as long as the maximum, a batch holds no more of them than its bytes allow
+			const size_t batch_lines = std::min(STREAM_BATCH_LINES, std::max<size_t>(1, STREAM_BATCH_BYTES / std::max<size_t>(1, max_length)));
 			for (auto nlevel : noise_levels)
-			{
-				auto t = tester_.generateInputs(number_tests, nlevel, max_length);
-				vals.insert(vals.end(), t.begin(), t.end());
-			}
-				
-
-			auto serialized = this->serializer_.serializeData(vals);
-			this->writer_.toFile(this->getOpt<std::string>(Values::INOUT_SOURCE_DATA), serialized);
+				for (size_t done = 0; done < number_tests; done += batch_lines)
+				{
+					auto vals = tester_.generateInputs(std::min(batch_lines, number_tests - done), nlevel, max_length);
+					if (write_index)
+						index.append(serializer_.indexData(vals, out.offset()));
+					out.write(serializer_, vals);
+					total += vals.size();
+				}
+			out.close();
+			if (write_index)
+				writeIndex_(source_path, std::move(index));
 
-			std::cout << vals.size() << " source inputs have successfully generated!";
+			status_(source_path) << total << " source inputs have successfully generated!";
 		}
 
+		const size_t
+			NTICommandLine::STREAM_BATCH_LINES = 4096,
+			NTICommandLine::STREAM_BATCH_BYTES = 64 << 20;
+
 		NTICommandLine::NTICommandLine(): CommandProcessor(VALUED_OPTS, FLAG_OPTS)
 		{
 		}
@@ -282,7 +934,9 @@ namespace nti
 			}
 			// anyway, proceed as normal
 			parseArgs_(argv, argc);
-			mode_ = getFlagVal(Flags::MODE_SEND_DATA) ? Mode::SEND : getFlagVal(Flags::MODE_GENERATE_DATA) ? Mode::GENERATE : Mode::CHECK; // get mode
+			mode_ = getFlagVal(Flags::MODE_SEND_DATA) ? Mode::SEND : getFlagVal(Flags::MODE_GENERATE_DATA) ? Mode::GENERATE :
+				getFlagVal(Flags::MODE_COMPARE) ? Mode::COMPARE : getFlagVal(Flags::MODE_ADAPTIVE) ? Mode::ADAPTIVE :
+				getFlagVal(Flags::MODE_SWEEP) ? Mode::SWEEP : Mode::CHECK; // get mode
 			switch (mode_)
 			{
 			case Mode::SEND:
@@ -294,6 +948,15 @@ namespace nti
 			case Mode::GENERATE:
 				doGenerateSource_();
 				break;
+			case Mode::COMPARE:
+				doCompare_();
+				break;
+			case Mode::ADAPTIVE:
+				doAdaptive_();
+				break;
+			case Mode::SWEEP:
+				doSweep_();
+				break;
 			case Mode::UNKNOWN:
 				throw std::runtime_error("Unknown mode to run");
 				break;
@@ -306,15 +969,65 @@ namespace nti
 "Usage <mode> [parameters...]\r\n\
 Modes available:\r\n\
   -g - generates 'num_sources'*|'noise_levels'| datasets for an encoding algorithm in \"encode\" mode.\r\n\
-\t Parameters are: -max_source_size <int> -noise_levels <array[float][0..1]> -num_sources <int> -io_sources <str>\r\n\
+\t Parameters are: -max_source_size <int> -noise_levels <array[float][0..1]> -num_sources <int> -io_sources <str> [-index]\r\n\
 \t Program generates a new dataset for \"encoding\" mode. For each noise level num_sources of tests will be generated.\r\n\
   -s - generates dataset for an encoding algorithm in \"decode\" mode.\r\n\
-\t Parameters are: -io_noised <str> -in_encoded <str> -io_sources <str> \r\n\
+\t Parameters are: -io_noised <str> -in_encoded <str> -io_sources <str> [-index] [-seed <int>]\r\n\
 \t Program generates a new dataset for \"decoding\" mode using coder's output and source data.\r\n\
+\t Optional: -repeat <int> - write this many noised variants of every encoded line, each from its own stream.\r\n\
+\t Optional: -bias <float> -io_weights <str> - importance sampling: flip bits with this probability instead of the\r\n\
+\t noise level of the test, and write 'flips bits log_ratio' of every test to 'io_weights'; 'log_ratio' is the log of\r\n\
+\t the likelihood ratio of its noise, nominal over biased. Redrawn characters count too.\r\n\
   -d - evaluates the accuracy and other parameters of both encoding and decoding algorithms.\r\n\
 \t Parameters are: -in_encoded <str> -in_decoded <str> -io_noised <str> -io_source <str> -out_report <str> \r\n\
 \t Program performs accuracy test, evaluates speed and other algorithm's parameters and writes them into 'out_report' file. \r\n\
+\t Optional: -select_tests <array[int]> -select_noise <array[float]> - check only these test numbers and/or noise levels.\r\n\
+\t Inputs are streamed in constant memory.\r\n\
+\t Optional: -retain_failed <int> -retain_policy <first|reservoir|worst|per_level> - how many failed tests the report lists\r\n\
+\t (1000 by default) and which: the first ones, a uniform sample, the ones with most errors or those per noise level.\r\n\
+\t Optional: -codeword_length <int> - also count residual error bits by offset modulo this length.\r\n\
+\t Optional: -edit_distance <int> - count errors of a decoded line as edits aligned to its source (up to this many,\r\n\
+\t at least 2), so a dropped or extra character is one error rather than the rest of the line. Failed tests are\r\n\
+\t then diffed by the alignment too.\r\n\
+\t Optional: -report_context <int> - show only this many characters around each error of a failed test.\r\n\
+\t Optional: -report_summary - leave failed tests out of the report.\r\n\
+\t Optional: -repeat <int> - the noised and decoded files hold this many variants of every source line ('-s -repeat');\r\n\
+\t the report then adds the failure probability per line with 95% intervals, and the lines failing most.\r\n\
+\t Optional: -io_weights <str> - the weights of a biased run ('-s -bias'); the report then adds the failure rate at the\r\n\
+\t nominal noise levels, weighted by likelihood ratio, with its standard error. Rare failures get seen far sooner,\r\n\
+\t but a bias far above the noise level makes a few weights dominate: keep 'effective failures' in the tens.\r\n\
+\t Optional: -out_heatmap <str> - write residual error bits by bit/offset and bursts by length as CSV ('map,key,count').\r\n\
+\t Optional: -fail_fast - stop as soon as the verdict cannot change; the report is then partial and\r\n\
+\t names the reason which decided it. The number of tests is taken from '<io_source>.idx' or by counting lines.\r\n\
+  -compare - checks two decoders, A and B, on the same tests and reports their verdicts with paired statistics.\r\n\
+\t Parameters are: -io_source <str> -io_noised <str> -in_encoded <str> -in_decoded <str> (of A)\r\n\
+\t -in_noised_b <str> -in_encoded_b <str> -in_decoded_b <str> (of B) -out_report <str>\r\n\
+\t Counts tests passed by only one of them (McNemar's test) and the difference of their residual BERs. To put both\r\n\
+\t on the same noise run '-s' for each with the same '-seed <int>': every test is then noised by its own\r\n\
+\t counter-based stream, flipping the same bits at the same positions of either encoding.\r\n\
+  -adaptive - runs the whole pipeline in rounds until the success rate at every noise level is known well enough.\r\n\
+\t Parameters are: -encoder <str> -decoder <str> -noise_levels <array[float][0..1]> -max_source_size <int>\r\n\
+\t -num_sources <int> -io_source <str> -in_encoded <str> -io_noised <str> -in_decoded <str> -out_report <str>\r\n\
+\t Every round generates 'num_sources' tests for each noise level still open and runs the codec commands on them\r\n\
+\t ('{in}' and '{out}' in a command stand for its files of the round). A level is settled once the 95% Wilson interval\r\n\
+\t of its success rate lies on one side of the threshold or is narrower than -ci_width <float> (0.02),\r\n\
+\t or after -max_tests <int> (100000) tests.\r\n\
+\t Optional: -seed <int>, and the options of -d which shape the report.\r\n\
+  -sweep - searches the highest noise level at which the decode success rate still meets the threshold.\r\n\
+\t Parameters are: -sweep_range <array[float][0..1]> (two levels, the lower is to pass and the higher to fail)\r\n\
+\t -encoder <str> -decoder <str> -max_source_size <int> -num_sources <int> -io_source <str> -in_encoded <str>\r\n\
+\t -io_noised <str> -in_decoded <str> -out_report <str>\r\n\
+\t Every round checks -candidates <int> (3) levels evenly spaced in the range on 'num_sources' tests each, in one\r\n\
+\t encoder and one decoder run, and narrows the range to the gap where they turn from passing to failing, until it is\r\n\
+\t narrower than -precision <float> (0.001). All levels are tested on the same sources, and a test flips at any level\r\n\
+\t the bits it flips at a lower one. Optional: -encode_once - the encoder does not depend on the noise level, so\r\n\
+\t the sources are encoded once for all rounds. Optional: -seed <int>, and the options of -d which shape the report.\r\n\
 \r\n\
+Note: any file option accepts '-' for stdin/stdout (at most one input per run) and named pipes, so stages\r\n\
+can be chained in a shell pipeline. '-s' consumes its inputs line by line as they arrive.\r\n\
+Note: '-index' writes a '<file>.idx' sidecar with line offsets and noise levels. '-d' uses such sidecars to seek straight\r\n\
+to selected tests instead of reading whole files. The source sidecar also keeps a fingerprint of every line, with it\r\n\
+'-d' reads only the sources of tests whose decoded lines do not match.\r\n\
 Note: data type '<array[type]>' is a coma (',') delimeted list of values of given type. \
 E.g.: <array[float[0..1]]> - 0,0.2,0.4,0.8,0.9,1\r\n\
 "
@@ -325,18 +1038,47 @@ E.g.: <array[float[0..1]]> - 0,0.2,0.4,0.8,0.9,1\r\n\
 			NTICommandLine::Values::PARAM_NOISE_LEVELS = "noise_levels",
 			NTICommandLine::Values::PARAM_SOURCE_MAXSIZE = "max_source_size",
 			NTICommandLine::Values::PARAM_NUM_SOURCES = "num_sources",
+			NTICommandLine::Values::PARAM_SELECT_TESTS = "select_tests",
+			NTICommandLine::Values::PARAM_SELECT_NOISE = "select_noise",
+			NTICommandLine::Values::PARAM_RETAIN_FAILED = "retain_failed",
+			NTICommandLine::Values::PARAM_RETAIN_POLICY = "retain_policy",
+			NTICommandLine::Values::PARAM_CODEWORD_LENGTH = "codeword_length",
+			NTICommandLine::Values::PARAM_EDIT_DISTANCE = "edit_distance",
+			NTICommandLine::Values::PARAM_REPORT_CONTEXT = "report_context",
+			NTICommandLine::Values::PARAM_NOISE_SEED = "seed",
+			NTICommandLine::Values::PARAM_ENCODER = "encoder",
+			NTICommandLine::Values::PARAM_DECODER = "decoder",
+			NTICommandLine::Values::PARAM_CI_WIDTH = "ci_width",
+			NTICommandLine::Values::PARAM_MAX_TESTS = "max_tests",
+			NTICommandLine::Values::PARAM_REPEAT = "repeat",
+			NTICommandLine::Values::PARAM_SWEEP_RANGE = "sweep_range",
+			NTICommandLine::Values::PARAM_PRECISION = "precision",
+			NTICommandLine::Values::PARAM_CANDIDATES = "candidates",
+			NTICommandLine::Values::PARAM_BIAS = "bias",
 			//NTICommandLine::Values::PARAM_DIFFICULTIES = "difficulties",
 
 			NTICommandLine::Values::INPUT_ENCODED_DATA = "in_encoded",
 			NTICommandLine::Values::INPUT_DECODED_DATA = "in_decoded",
+			NTICommandLine::Values::INPUT_ENCODED_DATA_B = "in_encoded_b",
+			NTICommandLine::Values::INPUT_DECODED_DATA_B = "in_decoded_b",
+			NTICommandLine::Values::INPUT_NOISED_DATA_B = "in_noised_b",
 			NTICommandLine::Values::INOUT_NOISED_DATA = "io_noised",
 			NTICommandLine::Values::OUTPUT_REPORT = "out_report",
-			NTICommandLine::Values::INOUT_SOURCE_DATA = "io_source";
+			NTICommandLine::Values::OUTPUT_HEATMAP = "out_heatmap",
+			NTICommandLine::Values::INOUT_SOURCE_DATA = "io_source",
+			NTICommandLine::Values::INOUT_WEIGHTS = "io_weights";
 
 		const std::string
 			NTICommandLine::Flags::MODE_CHECK_DECODE = "d",
 			NTICommandLine::Flags::MODE_SEND_DATA = "s",
-			NTICommandLine::Flags::MODE_GENERATE_DATA = "g";
+			NTICommandLine::Flags::MODE_GENERATE_DATA = "g",
+			NTICommandLine::Flags::MODE_COMPARE = "compare",
+			NTICommandLine::Flags::MODE_ADAPTIVE = "adaptive",
+			NTICommandLine::Flags::MODE_SWEEP = "sweep",
+			NTICommandLine::Flags::OPT_WRITE_INDEX = "index",
+			NTICommandLine::Flags::OPT_FAIL_FAST = "fail_fast",
+			NTICommandLine::Flags::OPT_REPORT_SUMMARY = "report_summary",
+			NTICommandLine::Flags::OPT_ENCODE_ONCE = "encode_once";
 			
 
 		const std::set<std::string>
@@ -345,17 +1087,46 @@ E.g.: <array[float[0..1]]> - 0,0.2,0.4,0.8,0.9,1\r\n\
 				//Values::PARAM_DIFFICULTIES ,
 				Values::PARAM_SOURCE_MAXSIZE,
 				Values::PARAM_NUM_SOURCES,
+				Values::PARAM_SELECT_TESTS,
+				Values::PARAM_SELECT_NOISE,
+				Values::PARAM_RETAIN_FAILED,
+				Values::PARAM_RETAIN_POLICY,
+				Values::PARAM_CODEWORD_LENGTH,
+				Values::PARAM_EDIT_DISTANCE,
+				Values::PARAM_REPORT_CONTEXT,
+				Values::PARAM_NOISE_SEED,
+				Values::PARAM_ENCODER,
+				Values::PARAM_DECODER,
+				Values::PARAM_CI_WIDTH,
+				Values::PARAM_MAX_TESTS,
+				Values::PARAM_REPEAT,
+				Values::PARAM_SWEEP_RANGE,
+				Values::PARAM_PRECISION,
+				Values::PARAM_CANDIDATES,
+				Values::PARAM_BIAS,
 				
 				Values::INPUT_ENCODED_DATA ,
 				Values::INOUT_NOISED_DATA  ,
 				Values::INPUT_DECODED_DATA ,
+				Values::INPUT_ENCODED_DATA_B,
+				Values::INPUT_DECODED_DATA_B,
+				Values::INPUT_NOISED_DATA_B,
 				Values::OUTPUT_REPORT	   ,
-				Values::INOUT_SOURCE_DATA
+				Values::OUTPUT_HEATMAP     ,
+				Values::INOUT_SOURCE_DATA,
+				Values::INOUT_WEIGHTS
 		}, 
 		NTICommandLine::FLAG_OPTS = {
 			Flags::MODE_CHECK_DECODE,
 			Flags::MODE_SEND_DATA,
-			Flags::MODE_GENERATE_DATA
+			Flags::MODE_GENERATE_DATA,
+			Flags::MODE_COMPARE,
+			Flags::MODE_ADAPTIVE,
+			Flags::MODE_SWEEP,
+			Flags::OPT_WRITE_INDEX,
+			Flags::OPT_FAIL_FAST,
+			Flags::OPT_REPORT_SUMMARY,
+			Flags::OPT_ENCODE_ONCE
 		};
 
 		template<const std::string &...modes>
@@ -376,18 +1147,24 @@ E.g.: <array[float[0..1]]> - 0,0.2,0.4,0.8,0.9,1\r\n\
 		{
 			static const auto& err_msg = "Either one option must be selected: -" + NTICommandLine::Flags::MODE_SEND_DATA +
 										 ", -" + NTICommandLine::Flags::MODE_GENERATE_DATA + 
-										 " or -" + NTICommandLine::Flags::MODE_CHECK_DECODE;
+										 ", -" + NTICommandLine::Flags::MODE_CHECK_DECODE +
+										 ", -" + NTICommandLine::Flags::MODE_COMPARE +
+										 ", -" + NTICommandLine::Flags::MODE_ADAPTIVE +
+										 " or -" + NTICommandLine::Flags::MODE_SWEEP;
 			return std::make_pair<bool, std::string>(
 				cmd.isOptSet(NTICommandLine::Flags::MODE_SEND_DATA) + 
 				cmd.isOptSet(NTICommandLine::Flags::MODE_CHECK_DECODE) + 
-				cmd.isOptSet(NTICommandLine::Flags::MODE_GENERATE_DATA) == 1, 
+				cmd.isOptSet(NTICommandLine::Flags::MODE_GENERATE_DATA) +
+				cmd.isOptSet(NTICommandLine::Flags::MODE_COMPARE) +
+				cmd.isOptSet(NTICommandLine::Flags::MODE_ADAPTIVE) +
+				cmd.isOptSet(NTICommandLine::Flags::MODE_SWEEP) == 1, 
 				std::string(err_msg));
 		};
 		auto __check_noise_dif(const NTICommandLine &cmd, const std::string &name, bool has)
 		{
 			static const auto& err_msg = "Either one option must be selected: -" + /*NTICommandLine::Values::PARAM_DIFFICULTIES + " or -" + */NTICommandLine::Values::PARAM_NOISE_LEVELS;
 			auto check_result = 0;
-			auto mode_ok = __check_must_be_in<NTICommandLine::Flags::MODE_GENERATE_DATA>(cmd, name, has);
+			auto mode_ok = __check_must_be_in<NTICommandLine::Flags::MODE_GENERATE_DATA, NTICommandLine::Flags::MODE_ADAPTIVE>(cmd, name, has);
 			if (!mode_ok.first)
 				return mode_ok;
 
@@ -424,13 +1201,106 @@ E.g.: <array[float[0..1]]> - 0,0.2,0.4,0.8,0.9,1\r\n\
                     }
                 }
                 },
-                 { Values::INOUT_NOISED_DATA,  {  __check_must_be_in <Flags::MODE_CHECK_DECODE, Flags::MODE_SEND_DATA> , nullptr } },
-                 { Values::INPUT_ENCODED_DATA, { __check_must_be_in<Flags::MODE_SEND_DATA, Flags::MODE_CHECK_DECODE>, nullptr } },
-                 { Values::INPUT_DECODED_DATA, { __check_must_be_in<Flags::MODE_CHECK_DECODE>, nullptr } },
-                 { Values::INOUT_SOURCE_DATA, { __check_must_be_in<Flags::MODE_GENERATE_DATA, Flags::MODE_SEND_DATA, Flags::MODE_CHECK_DECODE>, nullptr } },
-                 { Values::OUTPUT_REPORT,	  { __check_must_be_in<Flags::MODE_CHECK_DECODE>, nullptr } },
-                 { Values::PARAM_SOURCE_MAXSIZE,{ __check_must_be_in<Flags::MODE_GENERATE_DATA>, __value_check_int_range<1, 4'000'000>  } },
-                 { Values::PARAM_NUM_SOURCES,  { __check_must_be_in<Flags::MODE_GENERATE_DATA>, __value_check_int_range<1, INT_MAX> } },/**/
+                 { Values::INOUT_NOISED_DATA,  {  __check_must_be_in <Flags::MODE_CHECK_DECODE, Flags::MODE_SEND_DATA, Flags::MODE_COMPARE, Flags::MODE_ADAPTIVE, Flags::MODE_SWEEP> , nullptr } },
+                 { Values::INPUT_ENCODED_DATA, { __check_must_be_in<Flags::MODE_SEND_DATA, Flags::MODE_CHECK_DECODE, Flags::MODE_COMPARE, Flags::MODE_ADAPTIVE, Flags::MODE_SWEEP>, nullptr } },
+                 { Values::INPUT_DECODED_DATA, { __check_must_be_in<Flags::MODE_CHECK_DECODE, Flags::MODE_COMPARE, Flags::MODE_ADAPTIVE, Flags::MODE_SWEEP>, nullptr } },
+                 { Values::INPUT_NOISED_DATA_B, { __check_must_be_in<Flags::MODE_COMPARE>, nullptr } },
+                 { Values::INPUT_ENCODED_DATA_B, { __check_must_be_in<Flags::MODE_COMPARE>, nullptr } },
+                 { Values::INPUT_DECODED_DATA_B, { __check_must_be_in<Flags::MODE_COMPARE>, nullptr } },
+                 { Values::INOUT_SOURCE_DATA, { __check_must_be_in<Flags::MODE_GENERATE_DATA, Flags::MODE_SEND_DATA, Flags::MODE_CHECK_DECODE, Flags::MODE_COMPARE, Flags::MODE_ADAPTIVE, Flags::MODE_SWEEP>, nullptr } },
+                 { Values::OUTPUT_REPORT,	  { __check_must_be_in<Flags::MODE_CHECK_DECODE, Flags::MODE_COMPARE, Flags::MODE_ADAPTIVE, Flags::MODE_SWEEP>, nullptr } },
+                 { Flags::OPT_FAIL_FAST,	  { [](const NTICommandLine &cmd, const std::string &name, bool has)
+                    {
+                        return std::make_pair<bool, std::string>(!has || cmd.getFlagVal(Flags::MODE_CHECK_DECODE), "'-" + name + "' works only with -" + Flags::MODE_CHECK_DECODE);
+                    }, nullptr } },
+                 { Values::PARAM_SOURCE_MAXSIZE,{ __check_must_be_in<Flags::MODE_GENERATE_DATA, Flags::MODE_ADAPTIVE, Flags::MODE_SWEEP>, __value_check_int_range<1, 4'000'000>  } },
+                 { Values::PARAM_NUM_SOURCES,  { __check_must_be_in<Flags::MODE_GENERATE_DATA, Flags::MODE_ADAPTIVE, Flags::MODE_SWEEP>, __value_check_int_range<1, INT_MAX> } },
+                 { Values::PARAM_RETAIN_FAILED, { nullptr, __value_check_int_range<0, INT_MAX> } },
+                 { Values::PARAM_CODEWORD_LENGTH, { nullptr, __value_check_int_range<1, 1'000'000> } },
+                 { Values::PARAM_EDIT_DISTANCE, { nullptr, __value_check_int_range<1, 1'000'000> } },
+                 { Values::PARAM_NOISE_SEED, { nullptr, __value_check_int_range<0, INT_MAX> } },
+                 { Values::PARAM_REPORT_CONTEXT, { nullptr, __value_check_int_range<0, INT_MAX> } },
+                 { Flags::OPT_REPORT_SUMMARY, { [](const NTICommandLine &cmd, const std::string &name, bool has)
+                    {
+                        return std::make_pair<bool, std::string>(!has || cmd.getFlagVal(Flags::MODE_CHECK_DECODE) || cmd.getFlagVal(Flags::MODE_ADAPTIVE) || cmd.getFlagVal(Flags::MODE_SWEEP),
+                            "'-" + name + "' works only with -" + Flags::MODE_CHECK_DECODE + ", -" + Flags::MODE_ADAPTIVE + " or -" + Flags::MODE_SWEEP);
+                    }, nullptr } },
+                 { Values::PARAM_ENCODER, { __check_must_be_in<Flags::MODE_ADAPTIVE, Flags::MODE_SWEEP>, nullptr } },
+                 { Values::PARAM_DECODER, { __check_must_be_in<Flags::MODE_ADAPTIVE, Flags::MODE_SWEEP>, nullptr } },
+                 { Values::PARAM_CANDIDATES, { nullptr, __value_check_int_range<1, 64> } },
+                 { Values::PARAM_BIAS, { [](const NTICommandLine &cmd, const std::string &name, bool has)
+                    {
+                        return std::make_pair<bool, std::string>(!has || cmd.getFlagVal(Flags::MODE_SEND_DATA), "'-" + name + "' works only with -" + Flags::MODE_SEND_DATA);
+                    },
+                    [](const NTICommandLine &cmd, const std::string &name, const std::string &val)
+                    {
+                        auto bias = Parse<float>(val);
+                        return std::make_pair<bool, std::string>(bias > 0 && bias <= 1 && fabs(bias - 0.5f) >= INoiseProducer::NoiseProducerSettings::ERROR_EPS,
+                            "Value of '-" + name + "' must lie in (0, 1] interval and must not be close to a 0.5 value");
+                    }
+                }
+                },
+                 { Values::INOUT_WEIGHTS, { [](const NTICommandLine &cmd, const std::string &name, bool has)
+                    {
+                        bool biased = cmd.getFlagVal(Flags::MODE_SEND_DATA) && cmd.isOptSet(Values::PARAM_BIAS);
+                        return std::make_pair<bool, std::string>(has ? biased || cmd.getFlagVal(Flags::MODE_CHECK_DECODE) : !biased,
+                            "'-" + name + "' must be set with -" + Values::PARAM_BIAS + " and works only with it or with -" + Flags::MODE_CHECK_DECODE);
+                    }, nullptr } },
+                 { Values::PARAM_PRECISION, { nullptr,
+                    [](const NTICommandLine &cmd, const std::string &name, const std::string &val)
+                    {
+                        auto precision = Parse<float>(val);
+                        return std::make_pair<bool, std::string>(precision > 0 && precision < 1, "Value of '-" + name + "' must lie in (0, 1) interval");
+                    }
+                }
+                },
+                 { Values::PARAM_SWEEP_RANGE, { __check_must_be_in<Flags::MODE_SWEEP>,
+                    [](const NTICommandLine &cmd, const std::string &name, const std::string &val)
+                    {
+                        auto range = Parse<std::vector<float>>(val);
+                        bool success = range.size() == 2 && range[0] >= 0 && range[0] < range[1] &&
+                            (range[1] < 0.5f - INoiseProducer::NoiseProducerSettings::ERROR_EPS || range[0] > 0.5f + INoiseProducer::NoiseProducerSettings::ERROR_EPS) && range[1] <= 1;
+                        return std::make_pair<bool, std::string>(std::move(success), "Value of '-" + name + "' must be two increasing noise levels on one side of 0.5");
+                    }
+                }
+                },
+                 { Flags::OPT_ENCODE_ONCE, { [](const NTICommandLine &cmd, const std::string &name, bool has)
+                    {
+                        return std::make_pair<bool, std::string>(!has || cmd.getFlagVal(Flags::MODE_SWEEP), "'-" + name + "' works only with -" + Flags::MODE_SWEEP);
+                    }, nullptr } },
+                 { Values::PARAM_MAX_TESTS, { nullptr, __value_check_int_range<1, INT_MAX> } },
+                 { Values::PARAM_REPEAT, { [](const NTICommandLine &cmd, const std::string &name, bool has)
+                    {
+                        return std::make_pair<bool, std::string>(!has || cmd.getFlagVal(Flags::MODE_SEND_DATA) || cmd.getFlagVal(Flags::MODE_CHECK_DECODE),
+                            "'-" + name + "' works only with -" + Flags::MODE_SEND_DATA + " or -" + Flags::MODE_CHECK_DECODE);
+                    }, __value_check_int_range<1, 1'000'000> } },
+                 { Values::PARAM_CI_WIDTH, { nullptr,
+                    [](const NTICommandLine &cmd, const std::string &name, const std::string &val)
+                    {
+                        auto width = Parse<float>(val);
+                        return std::make_pair<bool, std::string>(width > 0 && width <= 1, "Value of '-" + name + "' must lie in (0, 1] interval");
+                    }
+                }
+                },
+                 { Values::PARAM_RETAIN_POLICY, { nullptr,
+                    [](const NTICommandLine &cmd, const std::string &name, const std::string &val)
+                    {
+                        bool success = true;
+                        try { FailureRetention::ParsePolicy(val); }
+                        catch (const std::runtime_error &) { success = false; }
+                        return std::make_pair<bool, std::string>(std::move(success), "Value of '-" + name + "' must be one of: first, reservoir, worst, per_level");
+                    }
+                }
+                },
+                 { Values::PARAM_SELECT_TESTS, { nullptr,
+                    [](const NTICommandLine &cmd, const std::string &name, const std::string &val)
+                    {
+                        auto parsed = Parse<std::vector<int>>(val);
+                        bool success = std::all_of(parsed.begin(), parsed.end(), [](int t) { return t >= 1; });
+                        return std::make_pair<bool, std::string>(std::move(success), "Test numbers of '-" + name + "' start from 1");
+                    }
+                }
+                },/**/
 		};
 		// END OF VALIDATORS
 		
@@ -128,7 +128,7 @@ namespace nti
 		class NTICommandLine : protected CommandProcessor
 		{
 			private:
-			enum class Mode { SEND, CHECK, GENERATE, UNKNOWN };
+			enum class Mode { SEND, CHECK, GENERATE, COMPARE, ADAPTIVE, SWEEP, UNKNOWN };
 			Mode mode_ = { Mode::UNKNOWN };
 			NTIChannelTesterSerializer serializer_;
 			NTIChannelTesterWriter writer_;
@@ -142,13 +142,45 @@ namespace nti
 			
 			void doAddNoise_() const;
 			void doCheckDecode_() const;
+			// streams the inputs batch by batch in constant memory, with fail fast stops as soon as the verdict is decided
+			void doCheckDecodeStream_() const;
 			void doGenerateSource_() const;
+			// checks two decoders on the same tests in one streaming pass, with paired statistics
+			void doCompare_() const;
+			// applies the options of the checker: retention, codeword length, edit distance
+			void configureTester_(IChannelTester &tester) const;
+			// generates, encodes, noises, decodes and checks batches of tests until the success rate of every noise level is settled
+			void doAdaptive_() const;
+			// searches the highest noise level at which the codec still meets the success rate threshold
+			void doSweep_() const;
+			// runs an external codec command, '{in}' and '{out}' in it are replaced by the paths, and returns what it wrote
+			std::vector<std::string> runCodec_(const std::string &command, const std::string &in_path, const std::string &out_path, size_t num_lines) const;
+
+			// sidecar index of the file if there is one, otherwise one built by scanning the file (which is kept in 'data')
+			LineIndex loadIndex_(const std::string &path, bool with_noise_levels, std::string &data) const;
+			// sidecar index of the file if there is one and it still fits the file, a stale one is reported and ignored
+			bool loadSidecar_(const std::string &path, LineIndex &index) const;
+			std::vector<std::string> readLines_(const std::string &path, const LineIndex &index, const std::string &data, const std::vector<size_t> &lines) const;
+			void writeIndex_(const std::string &path, LineIndex index) const;
+			// number of tests in a source file - from its sidecar index or by counting lines, 0 for stdin or a pipe
+			size_t countTests_(const std::string &path) const;
+			// CSV heatmap of the report, if it's asked for
+			void writeHeatmap_(const TestReport &report) const;
+			// how much of the failed tests the report shows
+			ReportLayout reportLayout_() const;
+
+			// where to report progress: stderr when the output itself goes to stdout
+			std::ostream &status_(const std::string &output_path) const;
+			void checkSingleStdin_(const std::vector<std::string> &input_paths) const;
 
 			public:
 			static const std::string HELP_TEXT;
+			// a streamed batch ends at whichever of the two comes first
+			static const size_t STREAM_BATCH_LINES, STREAM_BATCH_BYTES;
 
 			struct Flags {
-				static const std::string MODE_CHECK_DECODE, MODE_SEND_DATA, MODE_GENERATE_DATA;
+				static const std::string MODE_CHECK_DECODE, MODE_SEND_DATA, MODE_GENERATE_DATA, MODE_COMPARE, MODE_ADAPTIVE, MODE_SWEEP,
+					OPT_WRITE_INDEX, OPT_FAIL_FAST, OPT_REPORT_SUMMARY, OPT_ENCODE_ONCE;
 			};
 			struct Values
 			{
@@ -156,11 +188,33 @@ namespace nti
 					PARAM_SOURCE_MAXSIZE,
 					PARAM_NUM_SOURCES,
 					PARAM_NOISE_LEVELS,
-
+					PARAM_SELECT_TESTS,
+					PARAM_SELECT_NOISE,
+					PARAM_RETAIN_FAILED,
+					PARAM_RETAIN_POLICY,
+					PARAM_CODEWORD_LENGTH,
+					PARAM_EDIT_DISTANCE,
+					PARAM_REPORT_CONTEXT,
+					PARAM_NOISE_SEED,
+					PARAM_ENCODER,
+					PARAM_DECODER,
+					PARAM_CI_WIDTH,
+					PARAM_MAX_TESTS,
+					PARAM_REPEAT,
+					PARAM_SWEEP_RANGE,
+					PARAM_PRECISION,
+					PARAM_CANDIDATES,
+					PARAM_BIAS,
+
+					INOUT_WEIGHTS,
 					INPUT_ENCODED_DATA,
 					INPUT_DECODED_DATA,
+					INPUT_ENCODED_DATA_B,
+					INPUT_DECODED_DATA_B,
+					INPUT_NOISED_DATA_B,
 					INOUT_NOISED_DATA,
 					OUTPUT_REPORT,
+					OUTPUT_HEATMAP,
 					INOUT_SOURCE_DATA;
 						
 			};
@@ -0,0 +1,471 @@
+#include "compare.h"
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NTI_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace nti
+{
+	namespace
+	{
+		inline unsigned popcount32_(uint32_t v)
+		{
+#ifdef _MSC_VER
+			return __popcnt(v);
+#else
+			return __builtin_popcount(v);
+#endif
+		}
+
+		inline unsigned popcount64_(uint64_t v)
+		{
+#if defined(_MSC_VER) && defined(_M_X64)
+			return unsigned(__popcnt64(v));
+#elif defined(_MSC_VER)
+			return __popcnt(uint32_t(v)) + __popcnt(uint32_t(v >> 32));
+#else
+			return __builtin_popcountll(v);
+#endif
+		}
+
+		// differing bits of a[0..n) and b[0..n)
+		inline size_t xor_popcount_(const char *a, const char *b, size_t n)
+		{
+			size_t bits = 0, i = 0;
+			for (; i + 8 <= n; i += 8)
+			{
+				uint64_t wa, wb;
+				memcpy(&wa, a + i, 8);
+				memcpy(&wb, b + i, 8);
+				bits += popcount64_(wa ^ wb);
+			}
+			for (; i < n; ++i)
+				bits += popcount32_(uint8_t(a[i] ^ b[i]));
+			return bits;
+		}
+
+		inline unsigned ctz32_(uint32_t v)
+		{
+#ifdef _MSC_VER
+			unsigned long i;
+			_BitScanForward(&i, v);
+			return i;
+#else
+			return __builtin_ctz(v);
+#endif
+		}
+	}
+
+	const size_t CompareResult::NO_MISMATCH = size_t(-1);
+
+	CompareResult compare_lines(const char* a, size_t na, const char* b, size_t nb)
+	{
+		CompareResult ret;
+		const size_t n = std::min(na, nb);
+		size_t i = 0, run = 0; // mismatches in a row up to position i
+		auto extend_run = [&ret, &run](size_t length)
+		{
+			run += length;
+			ret.longest_burst = std::max(ret.longest_burst, run);
+		};
+		// every step yields a mask of differing bytes
+		auto account = [&ret, &i, &run, &extend_run, a, b](uint32_t diff, size_t step)
+		{
+			if (diff == 0)
+			{
+				run = 0;
+				return;
+			}
+			if (ret.first_mismatch == CompareResult::NO_MISMATCH)
+				ret.first_mismatch = i + ctz32_(diff);
+			ret.mismatches += popcount32_(diff);
+			ret.bit_errors += xor_popcount_(a + i, b + i, step);
+			if (step == 32 ? diff == 0xFFFFFFFFu : diff == (1u << step) - 1)
+				extend_run(step);
+			else
+				for (size_t k = 0; k < step; ++k)
+					if ((diff >> k) & 1)
+						extend_run(1);
+					else
+						run = 0;
+		};
+#if defined(__AVX2__)
+		for (; i + 32 <= n; i += 32)
+		{
+			auto va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+			auto vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+			account(~uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb))), 32);
+		}
+#elif defined(NTI_SSE2)
+		for (; i + 16 <= n; i += 16)
+		{
+			auto va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+			auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+			account(~uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb))) & 0xFFFFu, 16);
+		}
+#endif
+		for (; i < n; ++i)
+			if (a[i] != b[i])
+			{
+				if (ret.first_mismatch == CompareResult::NO_MISMATCH)
+					ret.first_mismatch = i;
+				++ret.mismatches;
+				ret.bit_errors += popcount32_(uint8_t(a[i] ^ b[i]));
+				extend_run(1);
+			}
+			else
+				run = 0;
+		if (na != nb)
+		{
+			if (ret.first_mismatch == CompareResult::NO_MISMATCH)
+				ret.first_mismatch = n;
+			ret.mismatches += std::max(na, nb) - n;
+			ret.bit_errors += 8 * (std::max(na, nb) - n);
+			extend_run(std::max(na, nb) - n);
+		}
+		return ret;
+	}
+
+	namespace
+	{
+		inline unsigned ctz64_(uint64_t v)
+		{
+#if defined(_MSC_VER) && defined(_M_X64)
+			unsigned long i;
+			_BitScanForward64(&i, v);
+			return i;
+#else
+			return uint32_t(v) ? ctz32_(uint32_t(v)) : 32 + ctz32_(uint32_t(v >> 32));
+#endif
+		}
+
+		// bit k is set if a[k] != b[k], k < 64
+		inline uint64_t diff_mask64_(const char *a, const char *b)
+		{
+#if defined(__AVX2__)
+			uint64_t eq = 0;
+			for (unsigned k = 0; k < 64; k += 32)
+			{
+				auto va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + k));
+				auto vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + k));
+				eq |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)))) << k;
+			}
+			return ~eq;
+#elif defined(NTI_SSE2)
+			uint64_t eq = 0;
+			for (unsigned k = 0; k < 64; k += 16)
+			{
+				auto va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + k));
+				auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + k));
+				eq |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)))) << k;
+			}
+			return ~eq;
+#else
+			uint64_t diff = 0;
+			for (unsigned k = 0; k < 64; ++k)
+				diff |= uint64_t(a[k] != b[k]) << k;
+			return diff;
+#endif
+		}
+	}
+
+	void mismatch_spans(const char* a, size_t na, const char* b, size_t nb, size_t glue, std::vector<std::pair<size_t, size_t>>& spans)
+	{
+		spans.clear();
+		auto add = [&spans, glue](size_t begin, size_t end)
+		{
+			if (!spans.empty() && begin - spans.back().second <= glue)
+				spans.back().second = end;
+			else
+				spans.emplace_back(begin, end);
+		};
+		const size_t n = std::min(na, nb);
+		size_t i = 0;
+		for (; i + 64 <= n; i += 64)
+		{
+			uint64_t diff = diff_mask64_(a + i, b + i);
+			while (diff)
+			{
+				unsigned begin = ctz64_(diff);
+				uint64_t equal_after = ~diff & (~uint64_t(0) << begin);
+				unsigned end = equal_after ? ctz64_(equal_after) : 64;
+				add(i + begin, i + end);
+				diff = end == 64 ? 0 : diff & (~uint64_t(0) << end);
+			}
+		}
+		for (; i < n; ++i)
+			if (a[i] != b[i])
+				add(i, i + 1);
+		if (na != nb)
+			add(n, std::max(na, nb));
+	}
+
+	const size_t ErrorHeatmap::MAX_BURST;
+
+	void ErrorHeatmap::merge(const ErrorHeatmap& other)
+	{
+		for (size_t i = 0; i < by_bit.size(); ++i)
+			by_bit[i] += other.by_bit[i];
+		for (size_t i = 0; i < by_offset.size() && i < other.by_offset.size(); ++i)
+			by_offset[i] += other.by_offset[i];
+		for (size_t i = 0; i < by_burst.size(); ++i)
+			by_burst[i] += other.by_burst[i];
+	}
+
+	void ErrorHeatmap::subtract(const ErrorHeatmap& other)
+	{
+		for (size_t i = 0; i < by_bit.size(); ++i)
+			by_bit[i] -= other.by_bit[i];
+		for (size_t i = 0; i < by_offset.size() && i < other.by_offset.size(); ++i)
+			by_offset[i] -= other.by_offset[i];
+		for (size_t i = 0; i < by_burst.size(); ++i)
+			by_burst[i] -= other.by_burst[i];
+	}
+
+	void accumulate_errors(const char* a, size_t na, const char* b, size_t nb, ErrorHeatmap& heatmap)
+	{
+		const size_t n = std::min(na, nb), codeword = heatmap.by_offset.size();
+		size_t run = 0;
+		auto close_run = [&heatmap, &run]()
+		{
+			if (run)
+				++heatmap.by_burst[std::min(run, ErrorHeatmap::MAX_BURST)];
+			run = 0;
+		};
+		// differing bits of one character
+		auto account = [&](size_t pos, unsigned x)
+		{
+			if (x == 0)
+			{
+				close_run();
+				return;
+			}
+			++run;
+			if (codeword)
+				heatmap.by_offset[pos % codeword] += popcount32_(x);
+		};
+
+		size_t i = 0;
+		const uint64_t lanes = 0x0101010101010101ULL;
+		for (; i + 8 <= n; i += 8)
+		{
+			uint64_t wa, wb;
+			memcpy(&wa, a + i, 8);
+			memcpy(&wb, b + i, 8);
+			uint64_t x = wa ^ wb;
+			if (x == 0)
+			{
+				close_run();
+				continue;
+			}
+			// bit k of all 8 characters at once
+			for (unsigned k = 0; k < 8; ++k)
+				heatmap.by_bit[k] += popcount64_(x & (lanes << k));
+			for (unsigned j = 0; j < 8; ++j)
+				account(i + j, unsigned(x >> (8 * j)) & 0xFFu);
+		}
+		for (; i < n; ++i)
+		{
+			unsigned x = uint8_t(a[i] ^ b[i]);
+			for (unsigned k = 0; k < 8; ++k)
+				heatmap.by_bit[k] += (x >> k) & 1;
+			account(i, x);
+		}
+		// the longer line's rest is a burst of fully wrong characters
+		for (size_t m = std::max(na, nb); i < m; ++i)
+		{
+			for (auto &bit : heatmap.by_bit)
+				++bit;
+			if (codeword)
+				heatmap.by_offset[i % codeword] += 8;
+			++run;
+		}
+		close_run();
+	}
+
+	namespace
+	{
+		const size_t BLOCK_ROWS = 64;
+
+		// one column of a 64-row block in Hyyro's formulation of Myers' algorithm: pv/mv - rows one more/less than
+		// the row above, eq - rows matching the character of the column, hin - change of the row above the block
+		// from the previous column. Returns the change of the block's last row.
+		inline int advance_block_(uint64_t &pv, uint64_t &mv, uint64_t eq, int hin)
+		{
+			const uint64_t hin_neg = hin < 0 ? 1 : 0;
+			uint64_t xv = eq | mv;
+			eq |= hin_neg;
+			uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+			uint64_t ph = mv | ~(xh | pv), mh = pv & xh;
+			int hout = int(ph >> 63) - int(mh >> 63);
+			ph = (ph << 1) | (hin > 0 ? 1 : 0);
+			mh = (mh << 1) | hin_neg;
+			pv = mh | ~(xv | ph);
+			mv = ph & xv;
+			return hout;
+		}
+
+		// value of row i of a block whose last row has the value 'score'
+		inline ptrdiff_t row_value_(uint64_t pv, uint64_t mv, ptrdiff_t score, size_t block, size_t i)
+		{
+			// rows below i are bits (i - first row of the block + 1) .. 63
+			size_t shift = i - block * BLOCK_ROWS;
+			uint64_t below = shift >= BLOCK_ROWS ? 0 : ~uint64_t(0) << shift;
+			return score - ptrdiff_t(popcount64_(pv & below)) + ptrdiff_t(popcount64_(mv & below));
+		}
+	}
+
+	EditResult edit_distance(const char *a, size_t na, const char *b, size_t nb, size_t max_distance, bool with_spans)
+	{
+		EditResult ret;
+		auto beyond = [&ret, max_distance]()
+		{
+			ret.distance = max_distance + 1;
+			ret.within_band = false;
+			return ret;
+		};
+		if ((na > nb ? na - nb : nb - na) > max_distance)
+			return beyond();
+		if (na == 0 || nb == 0)
+		{
+			ret.distance = na + nb;
+			if (ret.distance > max_distance)
+				return beyond();
+			if (with_spans && ret.distance)
+				ret.spans.push_back(EditSpan{ 0, na, 0, nb });
+			return ret;
+		}
+
+		// a is the pattern (rows), b the text (columns); match masks are kept per character class of a and block
+		const size_t blocks = (na + BLOCK_ROWS - 1) / BLOCK_ROWS;
+		std::array<size_t, 256> classes;
+		classes.fill(0); // 0 - not in a, matches nothing
+		size_t num_classes = 1;
+		for (size_t i = 0; i < na; ++i)
+		{
+			auto &c = classes[uint8_t(a[i])];
+			if (!c)
+				c = num_classes++;
+		}
+		std::vector<uint64_t> peq(num_classes * blocks, 0);
+		for (size_t i = 0; i < na; ++i)
+			peq[classes[uint8_t(a[i])] * blocks + i / BLOCK_ROWS] |= uint64_t(1) << (i % BLOCK_ROWS);
+
+		// column 0: every row is one more than the row above
+		std::vector<uint64_t> pv(blocks, ~uint64_t(0)), mv(blocks, 0);
+		std::vector<ptrdiff_t> score(blocks);
+		for (size_t k = 0; k < blocks; ++k)
+			score[k] = ptrdiff_t((k + 1) * BLOCK_ROWS);
+
+		// for the traceback: computed blocks of every column, from its first one on
+		std::vector<size_t> column_first, column_offset;
+		std::vector<uint64_t> trace_pv, trace_mv;
+		std::vector<ptrdiff_t> trace_score;
+
+		// a path of at most max_distance edits stays within max_distance of the diagonal. Cells outside of it are
+		// only ever overestimated (rows above the computed blocks grow by one per column, new blocks start one
+		// more per row than the block above), so every cell within the band with a value up to max_distance is exact.
+		size_t first = 0, last = 0;
+		for (size_t j = 1; j <= nb; ++j)
+		{
+			size_t lo = j > max_distance ? j - max_distance : 1, hi = std::min(na, j + max_distance);
+			size_t next_last = (hi - 1) / BLOCK_ROWS;
+			for (size_t k = last + 1; j > 1 && k <= next_last; ++k)
+			{
+				pv[k] = ~uint64_t(0);
+				mv[k] = 0;
+				score[k] = score[k - 1] + ptrdiff_t(BLOCK_ROWS);
+			}
+			first = (lo - 1) / BLOCK_ROWS;
+			last = next_last;
+
+			const uint64_t *eq = &peq[classes[uint8_t(b[j - 1])] * blocks];
+			int h = 1;
+			for (size_t k = first; k <= last; ++k)
+			{
+				h = advance_block_(pv[k], mv[k], eq[k], h);
+				score[k] += h;
+			}
+			if (with_spans)
+			{
+				column_first.push_back(first);
+				column_offset.push_back(trace_pv.size());
+				trace_pv.insert(trace_pv.end(), pv.begin() + first, pv.begin() + last + 1);
+				trace_mv.insert(trace_mv.end(), mv.begin() + first, mv.begin() + last + 1);
+				trace_score.insert(trace_score.end(), score.begin() + first, score.begin() + last + 1);
+			}
+		}
+
+		auto distance = row_value_(pv[last], mv[last], score[last], last, na);
+		if (distance > ptrdiff_t(max_distance))
+			return beyond();
+		ret.distance = size_t(distance);
+		if (!with_spans || distance == 0)
+			return ret;
+
+		const ptrdiff_t unknown = PTRDIFF_MAX / 2;
+		auto cell = [&](size_t i, size_t j) -> ptrdiff_t
+		{
+			if (j == 0)
+				return ptrdiff_t(i);
+			if (i == 0)
+				return ptrdiff_t(j);
+			size_t k = (i - 1) / BLOCK_ROWS, offset = column_offset[j - 1];
+			size_t count = (j < column_offset.size() ? column_offset[j] : trace_pv.size()) - offset;
+			if (k < column_first[j - 1] || k >= column_first[j - 1] + count)
+				return unknown;
+			size_t t = offset + k - column_first[j - 1];
+			return row_value_(trace_pv[t], trace_mv[t], trace_score[t], k, i);
+		};
+		// walks back from the end, consecutive edits are merged into one span
+		bool open = false;
+		auto edit = [&](size_t a_begin, size_t a_end, size_t b_begin, size_t b_end)
+		{
+			if (open)
+			{
+				ret.spans.back().a_begin = a_begin;
+				ret.spans.back().b_begin = b_begin;
+			}
+			else
+				ret.spans.push_back(EditSpan{ a_begin, a_end, b_begin, b_end });
+			open = true;
+		};
+		size_t i = na, j = nb;
+		while (i > 0 || j > 0)
+		{
+			if (i > 0 && j > 0 && a[i - 1] == b[j - 1] && cell(i - 1, j - 1) == distance)
+			{
+				open = false;
+				--i; --j;
+				continue;
+			}
+			if (i > 0 && j > 0 && cell(i - 1, j - 1) + 1 == distance)
+			{
+				edit(i - 1, i, j - 1, j);
+				--i; --j;
+			}
+			else if (j == 0 || (i > 0 && cell(i - 1, j) + 1 == distance))
+			{
+				edit(i - 1, i, j, j);
+				--i;
+			}
+			else
+			{
+				edit(i, i, j - 1, j);
+				--j;
+			}
+			--distance;
+		}
+		std::reverse(ret.spans.begin(), ret.spans.end());
+		return ret;
+	}
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <utility>
+
+namespace nti
+{
+	// Result of a position-by-position comparison of two lines
+	struct CompareResult
+	{
+		static const size_t NO_MISMATCH;
+
+		size_t first_mismatch = { NO_MISMATCH };
+		// differing positions over the common length plus the difference in length
+		size_t mismatches = { 0 };
+		// differing bits over the common length plus 8 bits per character of the difference in length
+		size_t bit_errors = { 0 };
+		// longest run of consecutive differing positions, the difference in length included
+		size_t longest_burst = { 0 };
+
+		bool equal() const { return mismatches == 0; }
+	};
+
+	// compares 16 (SSE2) or 32 (AVX2) bytes per step, finds the first mismatch and counts all of them in one pass.
+	// Bit errors and bursts are counted with 64-bit XOR + popcount, only over the steps that have mismatches.
+	CompareResult compare_lines(const char *a, size_t na, const char *b, size_t nb);
+
+	inline CompareResult compare_lines(const std::string &a, const std::string &b)
+	{
+		return compare_lines(a.data(), a.size(), b.data(), b.size());
+	}
+
+	// Ranges [first, second) where a and b differ position by position, the rest of the longer line included,
+	// merged when at most 'glue' equal characters lie between them. 64 bytes are compared per step and every run of
+	// differing bytes is taken from the mask at once. 'spans' is cleared, its storage is reused.
+	void mismatch_spans(const char *a, size_t na, const char *b, size_t nb, size_t glue, std::vector<std::pair<size_t, size_t>> &spans);
+
+	inline void mismatch_spans(const std::string &a, const std::string &b, size_t glue, std::vector<std::pair<size_t, size_t>> &spans)
+	{
+		mismatch_spans(a.data(), a.size(), b.data(), b.size(), glue, spans);
+	}
+
+	// A run of consecutive edits of an alignment: a[a_begin..a_end) turned into b[b_begin..b_end).
+	// Either range is empty for pure deletions and insertions.
+	struct EditSpan
+	{
+		size_t a_begin, a_end, b_begin, b_end;
+	};
+
+	// Result of an alignment of two lines by single-character insertions, deletions and substitutions
+	struct EditResult
+	{
+		// fewest edits turning a into b, max_distance + 1 if there are more than max_distance
+		size_t distance = { 0 };
+		bool within_band = { true };
+		std::vector<EditSpan> spans; // in order, only if asked for and within the band
+	};
+
+	// Myers' bit-vector edit distance, a is split into 64-row blocks and only the blocks crossing the diagonal band
+	// of 'max_distance' are computed column by column. Spans are traced back from the bit-vectors of every column.
+	EditResult edit_distance(const char *a, size_t na, const char *b, size_t nb, size_t max_distance, bool with_spans = false);
+
+	inline EditResult edit_distance(const std::string &a, const std::string &b, size_t max_distance, bool with_spans = false)
+	{
+		return edit_distance(a.data(), a.size(), b.data(), b.size(), max_distance, with_spans);
+	}
+
+	// Where errors land: differing bits by bit within the byte and by character offset modulo a codeword length,
+	// and runs of differing characters by their length. Characters beyond the shorter line count as 8 differing bits.
+	struct ErrorHeatmap
+	{
+		static const size_t MAX_BURST = 64; // longer bursts are counted in the last bucket
+
+		std::array<uint64_t, 8> by_bit = {};   // 0 - least significant
+		std::vector<uint64_t> by_offset;       // one per offset within the codeword, empty - not collected
+		std::array<uint64_t, MAX_BURST + 1> by_burst = {}; // by_burst[l] - bursts of l characters
+
+		explicit ErrorHeatmap(size_t codeword_length = 0) : by_offset(codeword_length) {}
+
+		void merge(const ErrorHeatmap &other);
+		void subtract(const ErrorHeatmap &other); // takes back what was accumulated into 'other' before
+	};
+
+	// adds the errors of a vs b to the heatmap; 64-bit XOR with lane-wise popcounts, words without errors are skipped
+	void accumulate_errors(const char *a, size_t na, const char *b, size_t nb, ErrorHeatmap &heatmap);
+
+	inline void accumulate_errors(const std::string &a, const std::string &b, ErrorHeatmap &heatmap)
+	{
+		accumulate_errors(a.data(), a.size(), b.data(), b.size(), heatmap);
+	}
+
+}
@@ -1,21 +1,466 @@
 #include "data.h"
 #include <chrono>
 #include "utils.h"
+#include "hash.h"
 #include <cstdlib>
 #include <ctime>
 #include <sstream>
 #include <cstring>
 #include <cerrno>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <iostream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace nti
 {
+	namespace
+	{
+		// binary layout of the index: "NTIX" | version | count | flags | offsets[count] | lengths[count] | noise_levels[count]?
+		const char INDEX_MAGIC[4] = { 'N', 'T', 'I', 'X' };
+		// version 2 adds fingerprints; indexes without them are still written as version 1
+		// version 3 records the size and modification time of the data file in the header
+		const uint32_t INDEX_VERSION = 1, INDEX_VERSION_FINGERPRINTS = 2, INDEX_VERSION_DATA_STAT = 3, INDEX_HAS_NOISE = 0x1, INDEX_HAS_FINGERPRINTS = 0x2;
+
+		template <typename T>
+		void append_pod_(std::string &out, const T *values, size_t count)
+		{
+			out.append(reinterpret_cast<const char*>(values), sizeof(T) * count);
+		}
+
+		template <typename T>
+		void read_pod_(const std::string &in, size_t &pos, T *values, size_t count) noexcept(false)
+		{
+			if (in.size() - pos < sizeof(T) * count)
+				throw std::runtime_error("[parseIndex] Index is truncated");
+			memcpy(values, in.data() + pos, sizeof(T) * count);
+			pos += sizeof(T) * count;
+		}
+	}
+
+	const std::string LineIndex::EXTENSION = ".idx";
+
+	std::vector<size_t> LineIndex::select(const std::vector<size_t>& tests, const std::vector<float>& levels) const noexcept(false)
+	{
+		if (!levels.empty() && !hasNoiseLevels())
+			throw std::runtime_error("[select] Index has no noise levels to select by");
+		std::vector<size_t> candidates = tests;
+		if (candidates.empty())
+		{
+			candidates.resize(size());
+			for (size_t i = 0; i < candidates.size(); ++i)
+				candidates[i] = i;
+		}
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+		std::vector<size_t> ret;
+		for (auto c : candidates)
+		{
+			if (c >= size())
+				throw std::runtime_error("[select] Test #" + std::to_string(c + 1) + " is out of range (" + std::to_string(size()) + " tests)");
+			if (!levels.empty() && std::none_of(levels.begin(), levels.end(), [this, c](float l) { return fabs(l - noise_levels[c]) < 1e-6f; }))
+				continue;
+			ret.push_back(c);
+		}
+		return ret;
+	}
+
+	bool LineIndex::describes(uint64_t size, uint64_t mtime) const noexcept
+	{
+		if (data_size || data_mtime)
+			return data_size == size && data_mtime == mtime;
+		uint64_t end = offsets.empty() ? 0 : offsets.back() + lengths.back();
+		return end <= size && size - end <= 2;
+	}
+
+	void LineIndex::append(const LineIndex& other)
+	{
+		offsets.insert(offsets.end(), other.offsets.begin(), other.offsets.end());
+		lengths.insert(lengths.end(), other.lengths.begin(), other.lengths.end());
+		noise_levels.insert(noise_levels.end(), other.noise_levels.begin(), other.noise_levels.end());
+		fingerprints.insert(fingerprints.end(), other.fingerprints.begin(), other.fingerprints.end());
+	}
+
+	LineIndex LineIndex::Scan(const std::string& data, uint64_t base_offset)
+	{
+		LineIndex ret;
+		auto ranges = split_ranges(data.data(), data.size(), "\r\n");
+		ret.offsets.reserve(ranges.size());
+		ret.lengths.reserve(ranges.size());
+		for (const auto &r : ranges)
+		{
+			ret.offsets.push_back(base_offset + r.first);
+			ret.lengths.push_back(static_cast<uint32_t>(r.second - r.first));
+		}
+		return ret;
+	}
+
+	const size_t NTIBufferedSink::BUFFER_SIZE = 4 << 20;
+
+	NTIBufferedSink::NTIBufferedSink(std::shared_ptr<std::ostream> out, const std::string& path, size_t buffer_size) :
+		out_(std::move(out)), path_(path), front_(buffer_size), back_(buffer_size)
+	{
+		flusher_ = std::thread(&NTIBufferedSink::flushLoop_, this);
+	}
+
+	void NTIBufferedSink::flushLoop_()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true)
+		{
+			cv_.wait(lock, [this]() { return back_pending_ || closing_; });
+			if (!back_pending_)
+				return;
+			lock.unlock();
+			// the back buffer belongs to this thread until 'back_pending_' is reset
+			out_->write(back_.data(), back_size_);
+			bool failed = out_->fail();
+			lock.lock();
+			if (failed && error_.empty())
+				error_ = "Failed to write to '" + path_ + "': " + strerror(errno);
+			back_pending_ = false;
+			cv_.notify_all();
+		}
+	}
+
+	void NTIBufferedSink::handOff_() noexcept(false)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		cv_.wait(lock, [this]() { return !back_pending_; });
+		if (!error_.empty())
+			throw std::runtime_error(error_);
+		std::swap(front_, back_);
+		back_size_ = front_size_;
+		front_size_ = 0;
+		back_pending_ = true;
+		cv_.notify_all();
+	}
+
+	void NTIBufferedSink::append(const char* data, size_t size) noexcept(false)
+	{
+		size_ += size;
+		while (size > 0)
+		{
+			auto n = std::min(size, front_.size() - front_size_);
+			memcpy(front_.data() + front_size_, data, n);
+			front_size_ += n;
+			data += n;
+			size -= n;
+			if (front_size_ == front_.size())
+				handOff_();
+		}
+	}
+
+	void NTIBufferedSink::close() noexcept(false)
+	{
+		if (closed_)
+			return;
+		// the flusher is stopped and joined whatever happens, a hand-off failing on an earlier write error included;
+		// that error is kept in 'error_' and thrown below
+		try
+		{
+			if (front_size_ > 0)
+				handOff_();
+		}
+		catch (std::runtime_error &)
+		{
+			front_size_ = 0;
+		}
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cv_.wait(lock, [this]() { return !back_pending_; });
+			closing_ = true;
+			cv_.notify_all();
+		}
+		flusher_.join();
+		closed_ = true;
+		out_->flush();
+		if (!error_.empty())
+			throw std::runtime_error(error_);
+		if (out_->fail())
+			throw std::runtime_error("Failed to write to '" + path_ + "': " + strerror(errno));
+	}
+
+	NTIBufferedSink::~NTIBufferedSink()
+	{
+		try
+		{
+			close();
+		}
+		catch (std::runtime_error &)
+		{
+			// nobody to report to from a destructor - call close() to get the error
+		}
+	}
+
+	SinkStreamBuf::int_type SinkStreamBuf::overflow(int_type ch)
+	{
+		if (traits_type::eq_int_type(ch, traits_type::eof()))
+			return traits_type::not_eof(ch);
+		char c = traits_type::to_char_type(ch);
+		sink_.append(&c, 1);
+		return ch;
+	}
+
+	std::streamsize SinkStreamBuf::xsputn(const char* s, std::streamsize n)
+	{
+		sink_.append(s, size_t(n));
+		return n;
+	}
+
+	const size_t LineReader::CHUNK_SIZE = 1 << 20;
+
+	LineReader::LineReader(std::shared_ptr<std::istream> in): in_(std::move(in))
+	{
+	}
+
+	bool LineReader::fill_()
+	{
+		// keep the unread tail, append the next chunk
+		buffer_.erase(0, pos_);
+		consumed_ += pos_;
+		pos_ = 0;
+		auto old_size = buffer_.size();
+		buffer_.resize(old_size + CHUNK_SIZE);
+		in_->read(&buffer_[old_size], CHUNK_SIZE);
+		buffer_.resize(old_size + size_t(in_->gcount()));
+		return buffer_.size() > old_size;
+	}
+
+	bool LineReader::next(std::string& line) noexcept(false)
+	{
+		if (done_)
+			return false;
+		if (!first_)
+		{
+			// skip every delimeter char, just like split does
+			while (true)
+			{
+				if (pos_ == buffer_.size() && !fill_())
+				{
+					done_ = true;
+					return false;
+				}
+				if (buffer_[pos_] != '\r' && buffer_[pos_] != '\n')
+					break;
+				++pos_;
+			}
+		}
+		first_ = false;
+		line.clear();
+		line_offset_ = consumed_ + pos_;
+		while (true)
+		{
+			if (pos_ == buffer_.size() && !fill_())
+				break;
+			auto cr = static_cast<const char*>(memchr(buffer_.data() + pos_, '\r', buffer_.size() - pos_));
+			if (cr == nullptr)
+			{
+				line.append(buffer_, pos_, buffer_.npos);
+				pos_ = buffer_.size();
+				continue;
+			}
+			size_t at = cr - buffer_.data();
+			line.append(buffer_, pos_, at - pos_);
+			pos_ = at;
+			if (pos_ + 1 == buffer_.size() && !fill_())
+			{
+				line.push_back('\r');
+				++pos_;
+				break;
+			}
+			if (buffer_[pos_ + 1] == '\n')
+			{
+				pos_ += 2;
+				return true;
+			}
+			line.push_back('\r');
+			++pos_;
+		}
+		if (in_->bad())
+			throw std::runtime_error(std::string("[LineReader] Failed to read a stream: ") + strerror(errno));
+		done_ = true;
+		return true;
+	}
+
+	std::string NTIChannelTesterSerializer::serializeIndex(const LineIndex& index) const
+	{
+		std::string out;
+		uint64_t count = index.size();
+		uint32_t flags = (index.hasNoiseLevels() ? INDEX_HAS_NOISE : 0) | (index.hasFingerprints() ? INDEX_HAS_FINGERPRINTS : 0);
+		out.reserve(sizeof(INDEX_MAGIC) + sizeof(INDEX_VERSION) + sizeof(count) + sizeof(flags) + 2 * sizeof(uint64_t) +
+					count * (sizeof(uint64_t) + sizeof(uint32_t) + (flags & INDEX_HAS_NOISE ? sizeof(float) : 0) +
+					(flags & INDEX_HAS_FINGERPRINTS ? sizeof(uint64_t) : 0)));
+		append_pod_(out, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+		append_pod_(out, &INDEX_VERSION_DATA_STAT, 1);
+		append_pod_(out, &count, 1);
+		append_pod_(out, &flags, 1);
+		append_pod_(out, &index.data_size, 1);
+		append_pod_(out, &index.data_mtime, 1);
+		append_pod_(out, index.offsets.data(), index.offsets.size());
+		append_pod_(out, index.lengths.data(), index.lengths.size());
+		if (flags & INDEX_HAS_NOISE)
+			append_pod_(out, index.noise_levels.data(), index.noise_levels.size());
+		if (flags & INDEX_HAS_FINGERPRINTS)
+			append_pod_(out, index.fingerprints.data(), index.fingerprints.size());
+		return out;
+	}
 	
-	std::string NTIChannelTesterSerializer::serializeData(const std::vector<UserTestInput>& data) const
+	namespace
+	{
+		// Formats noise levels as the shortest text that parses back to the same float, independent of the global locale.
+		// A corpus has a handful of distinct levels, so each one is formatted once and then copied.
+		class NoiseLevelFormatter
+		{
+			std::vector<std::pair<float, std::string>> cache_;
+		public:
+			const std::string &format(float level)
+			{
+				for (const auto &c : cache_)
+					if (c.first == level)
+						return c.second;
+				std::string text;
+				for (int precision = 1; precision <= std::numeric_limits<float>::max_digits10; ++precision)
+				{
+					std::ostringstream os;
+					os.imbue(std::locale::classic());
+					os << std::setprecision(precision) << level;
+					text = os.str();
+					std::istringstream is(text);
+					is.imbue(std::locale::classic());
+					float parsed;
+					if (is >> parsed && parsed == level)
+						break;
+				}
+				cache_.emplace_back(level, std::move(text));
+				return cache_.back().second;
+			}
+		};
+
+		const char RECORD_SEPARATOR = ' ', RECORD_END[] = "\r\n";
+
+		char *append_(char *out, const std::string &str)
+		{
+			memcpy(out, str.data(), str.size());
+			return out + str.size();
+		}
+
+		size_t records_size_(const UserTestInput *begin, const UserTestInput *end, NoiseLevelFormatter &levels)
+		{
+			size_t size = 0;
+			for (auto d = begin; d != end; ++d)
+				size += d->mode.size() + levels.format(d->noise_level).size() + d->input.size() + 2 + sizeof(RECORD_END) - 1;
+			return size;
+		}
+
+		char *write_records_(const UserTestInput *begin, const UserTestInput *end, char *out, NoiseLevelFormatter &levels)
+		{
+			for (auto d = begin; d != end; ++d)
+			{
+				out = append_(out, d->mode);
+				*out++ = RECORD_SEPARATOR;
+				out = append_(out, levels.format(d->noise_level));
+				*out++ = RECORD_SEPARATOR;
+				out = append_(out, d->input);
+				memcpy(out, RECORD_END, sizeof(RECORD_END) - 1);
+				out += sizeof(RECORD_END) - 1;
+			}
+			return out;
+		}
+	}
+
+	const size_t NTIChannelTesterSerializer::SERIALIZE_CHUNK_RECORDS = 256;
+
+	size_t NTIChannelTesterSerializer::serializedSize(const std::vector<UserTestInput>& data) const
+	{
+		NoiseLevelFormatter levels;
+		return records_size_(data.data(), data.data() + data.size(), levels);
+	}
+
+	char* NTIChannelTesterSerializer::serializeData(const std::vector<UserTestInput>& data, char* out) const
+	{
+		NoiseLevelFormatter levels;
+		return write_records_(data.data(), data.data() + data.size(), out, levels);
+	}
+
+	uint64_t NTIChannelTesterSerializer::serializeData(const std::vector<UserTestInput>& data, IPositionedOutput& out, uint64_t offset) const noexcept(false)
+	{
+		size_t num_chunks = (data.size() + SERIALIZE_CHUNK_RECORDS - 1) / SERIALIZE_CHUNK_RECORDS;
+		auto chunk = [&data](size_t c) { return std::make_pair(data.data() + c * SERIALIZE_CHUNK_RECORDS, data.data() + std::min(data.size(), (c + 1) * SERIALIZE_CHUNK_RECORDS)); };
+		// first pass - where every chunk goes
+		std::vector<uint64_t> offsets(num_chunks + 1, 0);
+		parallel_for(num_chunks, [&](size_t, size_t begin, size_t end)
+		{
+			NoiseLevelFormatter levels;
+			for (size_t c = begin; c < end; ++c)
+				offsets[c + 1] = records_size_(chunk(c).first, chunk(c).second, levels);
+		});
+		offsets[0] = offset;
+		for (size_t c = 0; c < num_chunks; ++c)
+			offsets[c + 1] += offsets[c];
+		out.reserve(offsets[num_chunks]);
+		// second pass - format and write every chunk at its place
+		parallel_for(num_chunks, [&](size_t, size_t begin, size_t end)
+		{
+			NoiseLevelFormatter levels;
+			std::vector<char> buffer;
+			for (size_t c = begin; c < end; ++c)
+			{
+				buffer.resize(size_t(offsets[c + 1] - offsets[c]));
+				write_records_(chunk(c).first, chunk(c).second, buffer.data(), levels);
+				out.writeAt(offsets[c], buffer.data(), buffer.size());
+			}
+		});
+		return offsets[num_chunks];
+	}
+
+	void NTIChannelTesterSerializer::serializeData(const std::vector<UserTestInput>& data, IOutputSink& out) const noexcept(false)
 	{
-		std::stringstream ss;
+		NoiseLevelFormatter levels;
 		for (const auto &d : data)
-			ss << d.mode << " " << d.noise_level << " " << d.input << "\r\n";
-		return ss.str();
+		{
+			out.append(d.mode);
+			out.append(&RECORD_SEPARATOR, 1);
+			out.append(levels.format(d.noise_level));
+			out.append(&RECORD_SEPARATOR, 1);
+			out.append(d.input);
+			out.append(RECORD_END, sizeof(RECORD_END) - 1);
+		}
+	}
+
+	LineIndex NTIChannelTesterSerializer::indexData(const std::vector<UserTestInput>& data, uint64_t base_offset) const
+	{
+		NoiseLevelFormatter levels;
+		LineIndex ret;
+		for (const auto &d : data)
+		{
+			auto length = d.mode.size() + levels.format(d.noise_level).size() + d.input.size() + 2;
+			ret.offsets.push_back(base_offset);
+			ret.lengths.push_back(static_cast<uint32_t>(length));
+			ret.noise_levels.push_back(d.noise_level);
+			ret.fingerprints.push_back(hash64(d.input));
+			base_offset += length + sizeof(RECORD_END) - 1;
+		}
+		return ret;
+	}
+
+	std::string NTIChannelTesterSerializer::serializeData(const std::vector<UserTestInput>& data) const
+	{
+		std::string ret(serializedSize(data), 0);
+		if (!ret.empty())
+			serializeData(data, &ret[0]);
+		return ret;
 	}
 
 	std::vector<std::string> NTIChannelTesterParser::parseCoderOutput(const std::string& encode_decode) const
@@ -28,37 +473,235 @@ namespace nti
 		auto inputs = split(input, "\r\n");
 		std::vector<UserTestInput> res;
 		for (const auto &in : inputs)
+			res.push_back(parseInputLine(in));
+		return res;
+	}
+
+	UserTestInput NTIChannelTesterParser::parseInputLine(const std::string& line) const
+	{
+		std::istringstream iss(line);
+		UserTestInput ui;
+		iss >> ui.mode >> ui.noise_level >> std::ws;
+		size_t pos = iss.tellg();
+		ui.input = line.substr(pos);
+		return ui;
+	}
+
+	NoiseLikelihood NTIChannelTesterParser::parseLikelihoodLine(const std::string& line) const noexcept(false)
+	{
+		NoiseLikelihood ret;
+		std::istringstream iss(line);
+		std::string log_ratio;
+		if (!(iss >> ret.flips >> ret.bits >> log_ratio))
+			throw std::runtime_error("[parseLikelihoodLine] Expected 'flips bits log_ratio', got '" + line + "'");
+		// strtod, unlike the stream, reads back the '-inf' of an impossible flip
+		ret.log_ratio = std::strtod(log_ratio.c_str(), nullptr);
+		return ret;
+	}
+
+	LineIndex NTIChannelTesterParser::parseIndex(const std::string& raw) const noexcept(false)
+	{
+		char magic[sizeof(INDEX_MAGIC)];
+		uint32_t version, flags;
+		uint64_t count;
+		size_t pos = 0;
+		read_pod_(raw, pos, magic, sizeof(magic));
+		read_pod_(raw, pos, &version, 1);
+		if (memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0 || version < INDEX_VERSION || version > INDEX_VERSION_DATA_STAT)
+			throw std::runtime_error("[parseIndex] Not an index or unsupported index version");
+		read_pod_(raw, pos, &count, 1);
+		read_pod_(raw, pos, &flags, 1);
+
+		LineIndex ret;
+		if (version >= INDEX_VERSION_DATA_STAT)
 		{
-			std::istringstream iss(in);
-			UserTestInput ui;
-			iss >> ui.mode >> ui.noise_level >> std::ws;
-			size_t pos = iss.tellg();
-			ui.input = in.substr(pos);
-			res.push_back(ui);
+			read_pod_(raw, pos, &ret.data_size, 1);
+			read_pod_(raw, pos, &ret.data_mtime, 1);
 		}
-		return res;
+		ret.offsets.resize(count);
+		ret.lengths.resize(count);
+		read_pod_(raw, pos, ret.offsets.data(), count);
+		read_pod_(raw, pos, ret.lengths.data(), count);
+		if (flags & INDEX_HAS_NOISE)
+		{
+			ret.noise_levels.resize(count);
+			read_pod_(raw, pos, ret.noise_levels.data(), count);
+		}
+		if (flags & INDEX_HAS_FINGERPRINTS)
+		{
+			ret.fingerprints.resize(count);
+			read_pod_(raw, pos, ret.fingerprints.data(), count);
+		}
+		return ret;
 	}
 
 
+	const std::string NTIChannelTesterWriter::STD_STREAM = "-";
+
+	std::shared_ptr<std::istream> NTIChannelTesterWriter::openInput(const std::string& path) const noexcept(false)
+	{
+		if (path == STD_STREAM)
+		{
+#ifdef _WIN32
+			_setmode(_fileno(stdin), _O_BINARY);
+#endif
+			return std::shared_ptr<std::istream>(&std::cin, [](std::istream*) {});
+		}
+		return SafeOpen(path, std::fstream::in | std::ios_base::binary);
+	}
+
+	std::shared_ptr<std::ostream> NTIChannelTesterWriter::openOutput(const std::string& path) const noexcept(false)
+	{
+		if (path == STD_STREAM)
+		{
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			return std::shared_ptr<std::ostream>(&std::cout, [](std::ostream*) { std::cout.flush(); });
+		}
+		return SafeOpen(path, std::fstream::out | std::fstream::binary);
+	}
+
+	std::unique_ptr<IOutputSink> NTIChannelTesterWriter::openSink(const std::string& path) const noexcept(false)
+	{
+		return std::make_unique<NTIBufferedSink>(openOutput(path), path);
+	}
+
+#ifndef _WIN32
+	namespace
+	{
+		class NTIPositionedFile : public IPositionedOutput
+		{
+			int fd_;
+			std::string path_;
+
+			[[noreturn]] void fail_(const std::string &what) const noexcept(false)
+			{
+				throw std::runtime_error("Failed to " + what + " '" + path_ + "': " + strerror(errno));
+			}
+		public:
+			NTIPositionedFile(int fd, const std::string &path) : fd_(fd), path_(path) {}
+
+			void reserve(uint64_t size) noexcept(false) override
+			{
+				if (ftruncate(fd_, off_t(size)) != 0)
+					fail_("resize");
+#ifdef __linux__
+				// a filesystem without fallocate still has the size set by ftruncate, a full one is reported now rather than mid-write
+				int err = posix_fallocate(fd_, 0, off_t(size));
+				if (err != 0 && err != EOPNOTSUPP && err != EINVAL)
+				{
+					errno = err;
+					fail_("reserve space for");
+				}
+#endif
+			}
+
+			void writeAt(uint64_t offset, const char *data, size_t size) noexcept(false) override
+			{
+				while (size > 0)
+				{
+					auto n = pwrite(fd_, data, size, off_t(offset));
+					if (n < 0)
+					{
+						if (errno == EINTR)
+							continue;
+						fail_("write to");
+					}
+					data += n; size -= size_t(n); offset += uint64_t(n);
+				}
+			}
+
+			void close() noexcept(false) override
+			{
+				if (fd_ >= 0 && ::close(fd_) != 0)
+				{
+					fd_ = -1;
+					fail_("close");
+				}
+				fd_ = -1;
+			}
+
+			~NTIPositionedFile() override
+			{
+				if (fd_ >= 0)
+					::close(fd_);
+			}
+		};
+	}
+#endif
+
+	std::unique_ptr<IPositionedOutput> NTIChannelTesterWriter::openPositioned(const std::string& path) const noexcept(false)
+	{
+#ifndef _WIN32
+		struct stat st;
+		if (path == STD_STREAM || (stat(path.c_str(), &st) == 0 && !S_ISREG(st.st_mode)))
+			return nullptr;
+		int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			throw std::runtime_error("Failed to open file '" + path + "': " + strerror(errno));
+		return std::make_unique<NTIPositionedFile>(fd, path);
+#else
+		return nullptr;
+#endif
+	}
+
 	void NTIChannelTesterWriter::toFile(const std::string& path, const std::string& data) const noexcept(false)
 	{
-		auto file = SafeOpen(path, std::fstream::out | std::fstream::binary);
-		*file << data;
+		auto file = openOutput(path);
+		file->write(data.data(), data.size());
+		file->flush();
 		if (file->fail())
 			throw std::runtime_error(std::string("Failed to write to '" + path + "': ") + strerror(errno));
 	}
 
 	std::string NTIChannelTesterWriter::fromFile(const std::string& path) const noexcept(false)
 	{
-		auto file = SafeOpen(path, std::fstream::in | std::ios_base::binary);
+		auto file = openInput(path);
 
 		std::string data((std::istreambuf_iterator<char>(*file)),
 			std::istreambuf_iterator<char>());
-		if (file->fail())
+		if (file->bad())
 			throw std::runtime_error("Failed to read from '" + path + "': " + strerror(errno));
 		return data;
 	}
 
+	std::vector<std::string> NTIChannelTesterWriter::fromFile(const std::string& path, const std::vector<std::pair<uint64_t, uint64_t>>& ranges) const noexcept(false)
+	{
+		if (path == STD_STREAM)
+			throw std::runtime_error("Cannot seek in stdin - select tests from regular files or their sidecar indexes");
+		auto file = SafeOpen(path, std::fstream::in | std::ios_base::binary);
+		std::vector<std::string> ret;
+		ret.reserve(ranges.size());
+		for (const auto &r : ranges)
+		{
+			std::string data(r.second, 0);
+			file->seekg(r.first);
+			file->read(&data[0], r.second);
+			if (file->fail())
+				throw std::runtime_error("Failed to read " + std::to_string(r.second) + " bytes at " + std::to_string(r.first) + " from '" + path + "': " + strerror(errno));
+			ret.push_back(std::move(data));
+		}
+		return ret;
+	}
+
+	bool NTIChannelTesterWriter::exists(const std::string& path) const noexcept
+	{
+		// do not open it - opening a FIFO would block or steal its writer
+		struct stat st;
+		return path != STD_STREAM && stat(path.c_str(), &st) == 0;
+	}
+
+	bool NTIChannelTesterWriter::fileStat(const std::string& path, uint64_t& size, uint64_t& mtime) const noexcept
+	{
+		struct stat st;
+		if (path == STD_STREAM || stat(path.c_str(), &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG)
+			return false;
+		size = uint64_t(st.st_size);
+		mtime = uint64_t(st.st_mtime);
+		return true;
+	}
+
 	std::unique_ptr<std::fstream> NTIChannelTesterWriter::SafeOpen(const std::string& path, int open_mode) noexcept(false)
 	{
 		auto file = std::make_unique<std::fstream>(path, (std::ios_base::openmode)(open_mode));
@@ -68,80 +711,429 @@ namespace nti
 	}
 
 
+	void NTIChannelTesterSerializer::serializeHeatmap(const ErrorHeatmap& heatmap, IOutputSink& out) const noexcept(false)
+	{
+		SinkStreamBuf buf(out);
+		std::ostream ss(&buf);
+		ss.exceptions(std::ios_base::badbit);
+		ss << "map,key,count\n";
+		for (size_t k = 0; k < heatmap.by_bit.size(); ++k)
+			ss << "bit," << k << "," << heatmap.by_bit[k] << "\n";
+		for (size_t k = 0; k < heatmap.by_offset.size(); ++k)
+			ss << "offset," << k << "," << heatmap.by_offset[k] << "\n";
+		// the last burst bucket holds everything longer
+		for (size_t k = 1; k < heatmap.by_burst.size(); ++k)
+			ss << "burst," << k << "," << heatmap.by_burst[k] << "\n";
+	}
+
+	void NTIChannelTesterSerializer::serializeEstimates(const SequentialEstimator& estimator, IOutputSink& out) const noexcept(false)
+	{
+		SinkStreamBuf buf(out);
+		std::ostream ss(&buf);
+		ss.exceptions(std::ios_base::badbit);
+		ss << "[ ADAPTIVE ]" << std::endl
+			<< "\tSuccess rate by noise level (95% Wilson interval) against the threshold " << estimator.threshold() << ":" << std::endl;
+		for (const auto &l : estimator.levels())
+			ss << "\t  " << l.noise_level << ": tests " << l.tests << ", passed " << l.successes
+				<< ", success " << (l.tests ? double(l.successes) / l.tests : 0) << " [" << l.low << ", " << l.high << "] - "
+				<< SequentialEstimator::VerdictName(l.verdict) << std::endl;
+		ss << std::endl;
+	}
+
+	void NTIChannelTesterSerializer::serializeRepeats(const RepeatStatistics& repeats, IOutputSink& out) const noexcept(false)
+	{
+		SinkStreamBuf buf(out);
+		std::ostream ss(&buf);
+		ss.exceptions(std::ios_base::badbit);
+		auto print_summary = [&ss](const RepeatStatistics::Summary &s)
+		{
+			ss << "lines " << s.lines << ", failure probability " << s.mean_failure << " [" << s.low << ", " << s.high << "]"
+				<< ", never failed " << s.never_failed << ", always failed " << s.always_failed << std::endl;
+		};
+		ss << "[ REPEATS ]" << std::endl
+			<< "\tEvery line noised " << repeats.repeat() << " times, mean per-line failure probability (95% interval):" << std::endl
+			<< "\t  overall: ";
+		print_summary(repeats.overall());
+		for (const auto &s : repeats.byNoiseLevel())
+		{
+			ss << "\t  " << s.noise_level << ": ";
+			print_summary(s);
+		}
+		auto worst = repeats.worst(REPORT_WORST_LINES);
+		if (!worst.empty())
+		{
+			ss << "\tLines failing most (95% Wilson interval):" << std::endl;
+			for (const auto &l : worst)
+				ss << "\t  line " << l.line + 1 << " (noise " << l.noise_level << "): failed " << l.failures << " of " << repeats.repeat()
+					<< " [" << l.low << ", " << l.high << "]" << std::endl;
+		}
+		ss << std::endl;
+	}
+
+	void NTIChannelTesterSerializer::serializeSweep(const ThresholdSweep& sweep, IOutputSink& out) const noexcept(false)
+	{
+		SinkStreamBuf buf(out);
+		std::ostream ss(&buf);
+		ss.exceptions(std::ios_base::badbit);
+		ss << "[ SWEEP ]" << std::endl
+			<< "\tHighest noise level with success rate of at least " << sweep.threshold() << ": " << ThresholdSweep::OutcomeName(sweep.outcome());
+		if (sweep.outcome() == ThresholdSweep::Outcome::FOUND)
+			ss << ", in [" << sweep.low() << ", " << sweep.high() << ")";
+		ss << std::endl;
+		for (size_t r = 0; r < sweep.rounds().size(); ++r)
+		{
+			ss << "\tRound " << r + 1 << ":" << std::endl;
+			for (const auto &p : sweep.rounds()[r])
+				ss << "\t  " << p.noise_level << ": tests " << p.tests << ", passed " << p.successes
+					<< ", success " << (p.tests ? double(p.successes) / p.tests : 0) << (p.passed ? " - passes" : " - fails") << std::endl;
+		}
+		ss << std::endl;
+	}
+
+	void NTIChannelTesterSerializer::serializeLikelihoods(const std::vector<NoiseLikelihood>& likelihoods, IOutputSink& out) const noexcept(false)
+	{
+		SinkStreamBuf buf(out);
+		std::ostream ss(&buf);
+		ss.exceptions(std::ios_base::badbit);
+		ss << std::setprecision(std::numeric_limits<double>::max_digits10);
+		for (const auto &l : likelihoods)
+			ss << l.flips << " " << l.bits << " " << l.log_ratio << "\r\n";
+	}
+
+	void NTIChannelTesterSerializer::serializeImportance(const ImportanceStatistics& importance, IOutputSink& out) const noexcept(false)
+	{
+		SinkStreamBuf buf(out);
+		std::ostream ss(&buf);
+		ss.exceptions(std::ios_base::badbit);
+		auto print_bucket = [&ss](const ImportanceBucket &b)
+		{
+			// normal approximation, it needs a fair number of effective failures to hold
+			double half = SequentialEstimator::Z_95 * b.standardError();
+			ss << "tests " << b.tests << ", failed " << b.failures << ", failure rate " << b.estimate()
+				<< " [" << std::max(0.0, b.estimate() - half) << ", " << b.estimate() + half << "], standard error " << b.standardError()
+				<< ", relative error " << b.relativeError() << ", effective failures " << b.effectiveFailures() << std::endl;
+		};
+		ss << "[ IMPORTANCE ]" << std::endl
+			<< "\tTests above were noised with a biased flip probability, the sections above describe that channel." << std::endl
+			<< "\tFailure rate at the nominal noise levels, weighted by likelihood ratio (95% interval):" << std::endl
+			<< "\t  overall: ";
+		print_bucket(importance.overall());
+		for (const auto &b : importance.byNoiseLevel())
+		{
+			ss << "\t  " << b.first << ": ";
+			print_bucket(b.second);
+		}
+		ss << std::endl;
+	}
+
+	void NTIChannelTesterSerializer::serializeComparison(const nti::TestReport& a, const nti::TestReport& b, const PairedStatistics& paired,
+		IOutputSink& out) const noexcept(false)
+	{
+		SinkStreamBuf buf(out);
+		std::ostream ss(&buf);
+		ss.exceptions(std::ios_base::badbit);
+		auto t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+		ss << "Report generated at: " << std::ctime(&t) << std::endl
+			<< "[ GENERAL ] (A / B)" << std::endl
+			<< "\tOverall (is passed?): " << std::boolalpha << a.has_passed << " / " << b.has_passed << std::endl;
+		if (!a.has_passed)
+			ss << "\tReason to failure of A: " << a.reasonToString() << std::endl;
+		if (!b.has_passed)
+			ss << "\tReason to failure of B: " << b.reasonToString() << std::endl;
+		ss
+			<< "\tTests total: " << a.num_success + a.num_failed << std::endl
+			<< "\tTests passed: " << a.num_success << " / " << b.num_success << std::endl
+			<< "\tOverall decode success rate: " << a.mean_decode_success_rate << " / " << b.mean_decode_success_rate << std::endl
+			<< "\tOverall encode speed rate: " << a.mean_encode_speed << " / " << b.mean_encode_speed << std::endl
+			<< "[ PAIRED ] (both decoders on the same tests and noise)" << std::endl;
+		auto print_bucket = [&ss](const PairedBucket &p)
+		{
+			const auto &d = p.ber_difference;
+			// normal approximation of the mean difference
+			double half = d.count() > 1 ? 1.96 * d.stddev() / std::sqrt(double(d.count())) : 0;
+			ss << "tests " << p.count() << ", passed by both " << p.both_passed << ", only by A " << p.only_a
+				<< ", only by B " << p.only_b << ", by neither " << p.both_failed
+				<< ", McNemar chi-square " << p.mcnemarStatistic() << " p-value " << p.mcnemarPValue()
+				<< ", residual BER A - B " << d.mean() << " (95% CI " << d.mean() - half << " .. " << d.mean() + half << ")" << std::endl;
+		};
+		ss << "\tOverall: ";
+		print_bucket(paired.overall());
+		if (!paired.byNoiseLevel().empty())
+		{
+			ss << "\tBy noise level:" << std::endl;
+			for (const auto &l : paired.byNoiseLevel())
+			{
+				ss << "\t  " << l.first << ": ";
+				print_bucket(l.second);
+			}
+		}
+		ss << "(p-values are exact below " << PairedBucket::EXACT_DISCORDANT << " tests passed by only one decoder)" << std::endl
+			<< std::endl << std::endl;
+	}
+
+	const size_t ReportLayout::WHOLE_LINES = size_t(-1);
+	const size_t NTIChannelTesterSerializer::REPORT_WINDOW_TESTS = 1024;
+	const size_t NTIChannelTesterSerializer::REPORT_WINDOW_BYTES = 64 << 20;
+	const size_t NTIChannelTesterSerializer::REPORT_WORST_LINES = 10;
+
+	namespace
+	{
+		// a failed test as the report lists it
+		struct ListedFailure
+		{
+			size_t test;
+			const UserTestInput *generated, *noised;
+			const std::string *decoded;
+			size_t offset; // of the lines shown, when they were cut
+			bool cut;
+		};
+
+		// renders failed tests one after another; error spans are [begin, end), their storage is reused
+		class FailureRenderer
+		{
+			static const size_t GLUE = 3;
+			static const char *const DELIM, *const ELISION;
+
+			std::ostream &os_;
+			size_t edit_distance_;
+			ReportLayout layout_;
+			std::vector<std::pair<size_t, size_t>> gen_errs_, dec_errs_;
+
+			// aligned edits, the ones closer than GLUE are merged; false if there are more than the band.
+			// The traceback keeps every column of its band, so the distance is found first and the spans are
+			// traced within the distance itself - a dropped character costs a band of one, not the whole one.
+			bool alignedPositions_(const std::string &gen, const std::string &dec)
+			{
+				auto band = std::min(edit_distance_, compare_lines(gen, dec).mismatches);
+				auto distance = edit_distance(gen, dec, band);
+				if (!distance.within_band)
+					return false;
+				auto aligned = edit_distance(gen, dec, distance.distance, true);
+				gen_errs_.clear();
+				dec_errs_.clear();
+				for (const auto &span : aligned.spans)
+				{
+					if (!gen_errs_.empty() && span.a_begin - gen_errs_.back().second <= GLUE)
+					{
+						gen_errs_.back().second = span.a_end;
+						dec_errs_.back().second = span.b_end;
+						continue;
+					}
+					gen_errs_.push_back(std::make_pair(span.a_begin, span.a_end));
+					dec_errs_.push_back(std::make_pair(span.b_begin, span.b_end));
+				}
+				return true;
+			}
+
+			// straight into the stream, no pieces of the line are copied; only the context around spans is shown
+			void printTransform_(const std::string &str, const std::vector<std::pair<size_t, size_t>> &err_positions)
+			{
+				const size_t context = layout_.context;
+				size_t prev = 0;
+				bool first = true;
+				for (auto &ep : err_positions)
+				{
+					// positions of another line may run past this one
+					auto begin = std::min(ep.first, str.size()), end = std::min(ep.second, str.size());
+					// a gap between two spans keeps the context after the one and before the other
+					auto gap = begin - prev;
+					if (gap > context && (first || gap - context > context))
+					{
+						if (!first)
+							os_.write(str.data() + prev, context);
+						os_ << ELISION;
+						prev = begin - context;
+					}
+					first = false;
+					os_.write(str.data() + prev, begin - prev) << DELIM;
+					os_.write(str.data() + begin, end - begin) << DELIM;
+					prev = end;
+				}
+				auto last = str.size() - prev > context ? prev + context : str.size();
+				os_.write(str.data() + prev, last - prev);
+				if (last < str.size())
+					os_ << ELISION;
+			}
+
+		public:
+			FailureRenderer(std::ostream &os, size_t edit_distance, const ReportLayout &layout) : os_(os), edit_distance_(edit_distance), layout_(layout) {}
+
+			void render(const ListedFailure &f)
+			{
+				const auto &gen = f.generated->input, &dec = *f.decoded;
+				os_ << "TEST #" << f.test + 1 << ". Noise level:" << f.generated->noise_level << std::endl;
+				if (f.cut)
+					os_ << "(lines are too long, " << gen.size() << " bytes of them from byte " << f.offset << " are shown)" << std::endl;
+				bool aligned = edit_distance_ && alignedPositions_(gen, dec);
+				if (!aligned)
+					mismatch_spans(gen, dec, GLUE, gen_errs_);
+				os_ << "GENERATED: "; printTransform_(gen, gen_errs_); os_ << std::endl;
+				os_ << "NOISED:    "; printTransform_(f.noised->input, gen_errs_); os_ << std::endl;
+				os_ << "DECODED:   "; printTransform_(dec, aligned ? dec_errs_ : gen_errs_); os_ << std::endl;
+
+				os_ << std::endl;
+			}
+		};
+
+		const size_t FailureRenderer::GLUE;
+		const char *const FailureRenderer::DELIM = "   ", *const FailureRenderer::ELISION = "[...]";
+	}
+
 	std::string NTIChannelTesterSerializer::serializeReport(
 		const nti::TestReport& report, const std::vector<UserTestInput> &generated,
-		const std::vector<UserTestInput> &noised, const std::vector<std::string> &decoded) const
+		const std::vector<UserTestInput> &noised, const std::vector<std::string> &decoded, const ReportLayout &layout) const
+	{
+		StringSink out;
+		serializeReport(report, generated, noised, decoded, out, layout);
+		return std::move(out.str());
+	}
+
+	void NTIChannelTesterSerializer::serializeReport(
+		const nti::TestReport& report, const std::vector<UserTestInput> &generated,
+		const std::vector<UserTestInput> &noised, const std::vector<std::string> &decoded, IOutputSink &out,
+		const ReportLayout &layout) const noexcept(false)
 	{
-		std::stringstream ss;
+		SinkStreamBuf buf(out);
+		std::ostream ss(&buf);
+		ss.exceptions(std::ios_base::badbit); // let the sink's errors through
 		auto t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
 		ss << "Report generated at: " << std::ctime(&t) << std::endl
 			<< "[ GENERAL ] " << std::endl
 			<< "\tOverall (is passed?): " << std::boolalpha << report.has_passed << std::endl;
 		if (!report.has_passed)
 			ss << "\tReason to failure: " << report.reasonToString() << std::endl;
+		if (report.is_partial)
+			ss << "\tStopped early (fail fast): verdict was decided after " << report.num_success + report.num_failed << " of "
+				<< (report.num_total_tests ? std::to_string(report.num_total_tests) : std::string("unknown number of")) << " tests" << std::endl;
 		ss
-			<< "\tTests total: " << report.num_success + report.failed_tests.size() << std::endl
+			<< "\tTests total: " << report.num_success + report.num_failed << std::endl
 			<< "\tTests passed: " << report.num_success << std::endl
-			<< "\tTests failed: " << report.failed_tests.size() << std::endl
+			<< "\tTests failed: " << report.num_failed << std::endl
 			<< "[ STATISTICS ]" << std::endl
 			<< "\tOverall decode success rate: " << report.mean_decode_success_rate << std::endl
 			<< "\tOverall encode speed rate: " << report.mean_encode_speed << std::endl
 			<< "\tError rate of most errors: " << report.least_successful_error_rate << std::endl;
+		if (!report.error_rates.empty())
+		{
+			ss << "\tBit error rates by noise level (channel - realized by noise, residual - left after decoding):" << std::endl;
+			auto print_rate = [&ss](double rate) -> std::ostream& { return rate < 0 ? ss << "N/A" : ss << rate; };
+			for (const auto &e : report.error_rates)
+			{
+				ss << "\t  " << e.noise_level << ": tests " << e.num_tests << ", channel ";
+				print_rate(e.channel_ber_mean) << ", residual mean " << e.residual_ber_mean << " p50 ";
+				print_rate(e.residual_ber_p50) << " p90 ";
+				print_rate(e.residual_ber_p90) << " p99 ";
+				print_rate(e.residual_ber_p99) << " max " << e.residual_ber_max << std::endl;
+			}
+		}
+		const auto &dist = report.statistics.distributions();
+		if (dist.source_length.count())
+		{
+			auto print_sketch = [&ss](const char *name, const QuantileSketch &q)
+			{
+				ss << "\t  " << name << ": " << q.quantile(0.5) << " / " << q.quantile(0.99) << " / " << q.quantile(0.999) << " / " << q.max() << std::endl;
+			};
+			ss << "\tDistributions (p50 / p99 / p999 / max, within 3%):" << std::endl;
+			print_sketch("expansion (encoded / source size)", dist.expansion);
+			print_sketch("source length", dist.source_length);
+			print_sketch("residual bit errors per test", dist.residual_bits);
+			print_sketch("longest decode error burst", dist.longest_burst);
+			ss << "\tDistinct sources (estimated): " << std::llround(dist.sources.estimate()) << std::endl;
+		}
+		const auto &heatmap = report.heatmap;
+		if (std::any_of(heatmap.by_bit.begin(), heatmap.by_bit.end(), [](uint64_t c) { return c != 0; }))
+		{
+			ss << "\tResidual error bits by bit of the byte (0 - least significant):";
+			for (auto c : heatmap.by_bit)
+				ss << " " << c;
+			ss << std::endl;
+			if (!heatmap.by_offset.empty())
+			{
+				ss << "\tResidual error bits by offset modulo " << heatmap.by_offset.size() << ":";
+				for (auto c : heatmap.by_offset)
+					ss << " " << c;
+				ss << std::endl;
+			}
+			ss << "\tResidual error bursts by length:";
+			const char *sep = " ";
+			for (size_t l = 1; l < heatmap.by_burst.size(); ++l)
+				if (heatmap.by_burst[l])
+				{
+					ss << sep << l << (l == ErrorHeatmap::MAX_BURST ? "+" : "") << ": " << heatmap.by_burst[l];
+					sep = ", ";
+				}
+			ss << std::endl;
+		}
+		auto print_bucket = [&ss](const BucketStats &b)
+		{
+			ss << "tests " << b.success.count() << ", success " << b.success.mean()
+				<< ", rate " << b.rate.mean() << " (sd " << b.rate.stddev() << ")"
+				<< ", residual errors " << b.residual_errors.mean() << " (sd " << b.residual_errors.stddev() << ", max " << b.residual_errors.max() << ")"
+				<< ", residual BER " << b.residual_ber.mean() << " (sd " << b.residual_ber.stddev() << ")";
+			if (b.channel_ber.count())
+				ss << ", channel BER " << b.channel_ber.mean() << " (sd " << b.channel_ber.stddev() << ")";
+			ss << std::endl;
+		};
+		if (!report.statistics.byNoiseLevel().empty())
+		{
+			ss << "\tBy noise level:" << std::endl;
+			for (const auto &b : report.statistics.byNoiseLevel())
+			{
+				ss << "\t  " << b.first << ": ";
+				print_bucket(b.second);
+			}
+			ss << "\tBy source length:" << std::endl;
+			const auto &by_length = report.statistics.byLength();
+			for (size_t k = 0; k < by_length.size(); ++k)
+				if (by_length[k].success.count())
+				{
+					ss << "\t  [" << (k ? size_t(1) << k : 0) << ", " << (size_t(1) << (k + 1)) << "): ";
+					print_bucket(by_length[k]);
+				}
+		}
 
-		if (report.failed_tests.size() > 0)
+		if (report.num_failed > 0 && !layout.summary)
 		{
 			ss << "[ FOR DEBUG ]" << std::endl
 				<< "\tFailed tests: " << std::endl
 				<< "(Below are the tests which decoder failed to pass)" << std::endl;
 
-			auto get_err_positions = [](const UserTestInput &gen, const std::string &dec, size_t glue_threshold = 0) {
-				std::vector<std::pair<size_t, size_t>> vec;
-				for (size_t i = 0, sg = gen.input.size(), sd = dec.size(), glue = 0, tstart = -1, tend = -1; i<sg && i<sd; ++i, ++glue)
-				{
-					if (tstart != -1 && tend != -1 && glue > glue_threshold)
-					{
-						vec.push_back(std::make_pair(tstart, tend));
-						tstart = tend = -1;
-					}
-					if (dec[i] != gen.input[i])
-					{
-						glue = 0; // reset glue
-						if (tstart != -1)
-							tend = i;
-						else
-							tstart = i;
-					}
-					else
-						tend = i;
-				}
-				return vec;
-			};
-			auto print_transform = [&ss](const std::string str, const std::string &delim, const std::vector<std::pair<size_t, size_t>> &err_positions)
+			std::vector<ListedFailure> listed;
+			listed.reserve(report.failed_tests.size() + report.failed_samples.size());
+			for (auto i : report.failed_tests)
+				listed.push_back(ListedFailure{ report.test_ids.empty() ? i : report.test_ids[i], &generated[i], &noised[i], &decoded[i], 0, false });
+			for (const auto &f : report.failed_samples)
+				listed.push_back(ListedFailure{ f.test, &f.source, &f.noised, &f.decoded, f.offset, f.cut });
+			// every shard renders its part of a window into its own buffer, buffers are written out in order
+			// a window is bounded by the bytes of its lines too, as rendered it never takes more than them and a few labels
+			auto rendered_size = [](const ListedFailure &f) { return f.generated->input.size() + f.noised->input.size() + f.decoded->size() + 64; };
+			for (size_t w = 0, count = 0; w < listed.size(); w += count)
 			{
-				size_t prev = 0;
-				for (auto &ep : err_positions)
+				size_t bytes = rendered_size(listed[w]);
+				for (count = 1; count < REPORT_WINDOW_TESTS && w + count < listed.size(); ++count)
 				{
-					ss << str.substr(prev, ep.first - prev) << delim << str.substr(ep.first, ep.second + 1 - ep.first) << delim;
-					prev = ep.second;
+					bytes += rendered_size(listed[w + count]);
+					if (bytes > REPORT_WINDOW_BYTES)
+						break;
 				}
-				if (prev < str.size()) // something left? print it
-					ss << str.substr(prev);
-			};
-			for (auto i : report.failed_tests)
-			{
-				ss << "TEST #" << i + 1 << ". Noise level:" << generated[i].noise_level << std::endl;
-				auto errs = get_err_positions(generated[i], decoded[i], 3);
-				ss << "GENERATED: "; print_transform(generated[i].input, "   ", errs); ss << std::endl;
-				ss << "NOISED:    "; print_transform(noised[i].input, "   ", errs); ss << std::endl;
-				ss << "DECODED:   "; print_transform(decoded[i], "   ", errs); ss << std::endl;
-
-				ss << std::endl;
+				std::vector<StringSink> buffers(parallel_shards(count));
+				parallel_for(count, [&](size_t shard, size_t begin, size_t end)
+				{
+					SinkStreamBuf shard_buf(buffers[shard]);
+					std::ostream os(&shard_buf);
+					FailureRenderer renderer(os, report.edit_distance, layout);
+					for (size_t i = begin; i < end; ++i)
+						renderer.render(listed[w + i]);
+				});
+				for (auto &b : buffers)
+					ss.write(b.str().data(), b.str().size());
 			}
+			auto shown = report.failed_tests.size() + report.failed_samples.size();
+			if (shown < report.num_failed)
+				ss << "(" << shown << " of " << report.num_failed << " failed tests are shown, chosen by '" << report.retention << "' retention)" << std::endl;
 		}
 
 		ss
 			<< std::endl << std::endl;
-
-		return ss.str();
 	}
 }
\ No newline at end of file
@@ -2,16 +2,187 @@
 #include <string>
 #include "tester.h"
 #include <fstream>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 
 namespace nti
 {
+	// Sidecar index of a text corpus ('<file>.idx'): where every line starts, how long it is
+	// and (for -g/-s outputs) its noise level. Lets us seek straight to test #k.
+	struct LineIndex
+	{
+		static const std::string EXTENSION;
+
+		std::vector<uint64_t> offsets;
+		std::vector<uint32_t> lengths;
+		std::vector<float> noise_levels; // empty for coder outputs
+		std::vector<uint64_t> fingerprints; // hash64 of every test input, empty if not recorded
+		// size and modification time (seconds) of the data file the index was written for, 0 - not recorded
+		uint64_t data_size = { 0 }, data_mtime = { 0 };
+
+		size_t size() const { return offsets.size(); }
+		// whether the index still fits a data file of this size and modification time; without them recorded only
+		// the end of the last line is checked against the size (a line delimiter may follow it)
+		bool describes(uint64_t size, uint64_t mtime) const noexcept;
+		bool hasNoiseLevels() const { return !noise_levels.empty(); }
+		bool hasFingerprints() const { return !fingerprints.empty(); }
+
+		// zero-based numbers of tests which are in 'tests' (if any given) and have one of 'noise_levels' (if any given)
+		std::vector<size_t> select(const std::vector<size_t> &tests, const std::vector<float> &noise_levels) const noexcept(false);
+
+		void append(const LineIndex &other);
+
+		// builds offsets (shifted by 'base_offset') and lengths of the lines that 'split(data, "\r\n")' would produce
+		static LineIndex Scan(const std::string &data, uint64_t base_offset = 0);
+	};
+
+	// Reads "\r\n"-delimited lines from a stream one by one, yielding exactly what 'split' would yield
+	// for the whole stream. Works on pipes and stdin - nothing is ever seeked.
+	class LineReader
+	{
+		static const size_t CHUNK_SIZE;
+
+		std::shared_ptr<std::istream> in_;
+		std::string buffer_;
+		size_t pos_ = { 0 };
+		uint64_t consumed_ = { 0 }, line_offset_ = { 0 };
+		bool first_ = { true }, done_ = { false };
+
+		bool fill_();
+	public:
+		explicit LineReader(std::shared_ptr<std::istream> in);
+
+		bool next(std::string &line) noexcept(false);
+		// byte offset of the line returned last
+		uint64_t lineOffset() const { return line_offset_; }
+	};
+
+	// Accepts output chunk by chunk. Implementations may write it out in the background - call 'close' to make sure it's all written.
+	class IOutputSink
+	{
+	public:
+		virtual void append(const char *data, size_t size) noexcept(false) = 0;
+		void append(const std::string &data) noexcept(false) { append(data.data(), data.size()); }
+		// number of bytes appended so far
+		virtual uint64_t size() const = 0;
+		virtual void close() noexcept(false) = 0;
+
+		virtual ~IOutputSink() = default;
+	};
+
+	// Collects the output in a string
+	class StringSink : public IOutputSink
+	{
+		std::string data_;
+	public:
+		void append(const char *data, size_t size) override { data_.append(data, size); }
+		using IOutputSink::append;
+		uint64_t size() const override { return data_.size(); }
+		void close() override {}
+
+		std::string &str() { return data_; }
+	};
+
+	// Double-buffered sink: the producer fills one buffer while a background thread writes the other one out
+	class NTIBufferedSink : public IOutputSink
+	{
+		std::shared_ptr<std::ostream> out_;
+		std::string path_;
+		std::vector<char> front_, back_;
+		size_t front_size_ = { 0 }, back_size_ = { 0 };
+		uint64_t size_ = { 0 };
+		bool back_pending_ = { false }, closing_ = { false }, closed_ = { false };
+		std::string error_;
+		std::mutex mutex_;
+		std::condition_variable cv_;
+		std::thread flusher_;
+
+		void flushLoop_();
+		void handOff_() noexcept(false);
+	public:
+		static const size_t BUFFER_SIZE;
+
+		NTIBufferedSink(std::shared_ptr<std::ostream> out, const std::string &path, size_t buffer_size = BUFFER_SIZE);
+
+		void append(const char *data, size_t size) noexcept(false) override;
+		using IOutputSink::append;
+		uint64_t size() const override { return size_; }
+		void close() noexcept(false) override;
+
+		~NTIBufferedSink() override;
+	};
+
+	// Output file that can be written at known offsets from many threads at once
+	class IPositionedOutput
+	{
+	public:
+		// grows the file to 'size' bytes, preallocating the space
+		virtual void reserve(uint64_t size) noexcept(false) = 0;
+		virtual void writeAt(uint64_t offset, const char *data, size_t size) noexcept(false) = 0;
+		virtual void close() noexcept(false) = 0;
+
+		virtual ~IPositionedOutput() = default;
+	};
+
+	// std::ostream interface over a sink, for text formatted with operator<<
+	class SinkStreamBuf : public std::streambuf
+	{
+		IOutputSink &sink_;
+	protected:
+		int_type overflow(int_type ch) override;
+		std::streamsize xsputn(const char *s, std::streamsize n) override;
+	public:
+		explicit SinkStreamBuf(IOutputSink &sink) : sink_(sink) {}
+	};
+
+	// how much of the failed tests a report shows
+	struct ReportLayout
+	{
+		static const size_t WHOLE_LINES;
+
+		size_t context = { WHOLE_LINES }; // characters shown on either side of an error span, the rest is elided
+		bool summary = { false }; // no failed tests at all
+	};
+
 	class IChannelTesterSerialzer
 	{
 	public:
 		virtual std::string serializeData(const std::vector<UserTestInput> &data) const = 0;
+		// exact number of bytes 'serializeData' produces
+		virtual size_t serializedSize(const std::vector<UserTestInput> &data) const = 0;
+		// writes exactly 'serializedSize(data)' bytes into 'out', returns the end of written data
+		virtual char *serializeData(const std::vector<UserTestInput> &data, char *out) const = 0;
+		virtual void serializeData(const std::vector<UserTestInput> &data, IOutputSink &out) const noexcept(false) = 0;
+		// index of what 'serializeData' writes for 'data' when it starts at 'base_offset'
+		virtual LineIndex indexData(const std::vector<UserTestInput> &data, uint64_t base_offset = 0) const = 0;
+		// serializes in parallel: sizes of all chunks first, then every thread formats and writes its chunks at their offsets.
+		// Returns where the written data ends.
+		virtual uint64_t serializeData(const std::vector<UserTestInput> &data, IPositionedOutput &out, uint64_t offset) const noexcept(false) = 0;
+		virtual std::string serializeIndex(const LineIndex &index) const = 0;
 		virtual std::string serializeReport(const nti::TestReport& report, const std::vector<UserTestInput> &generated,
-			const std::vector<UserTestInput> &noised, const std::vector<std::string> &decoded) const = 0;
+			const std::vector<UserTestInput> &noised, const std::vector<std::string> &decoded, const ReportLayout &layout = ReportLayout()) const = 0;
+		// failed tests are rendered in parallel, a window of them at a time, and written to 'out' in order
+		virtual void serializeReport(const nti::TestReport& report, const std::vector<UserTestInput> &generated,
+			const std::vector<UserTestInput> &noised, const std::vector<std::string> &decoded, IOutputSink &out,
+			const ReportLayout &layout = ReportLayout()) const noexcept(false) = 0;
+		// heatmap as CSV rows 'map,key,count' (maps: bit, offset, burst) for tools to pick up
+		virtual void serializeHeatmap(const ErrorHeatmap &heatmap, IOutputSink &out) const noexcept(false) = 0;
+		// success rate estimates of an adaptive run, by noise level
+		virtual void serializeEstimates(const SequentialEstimator &estimator, IOutputSink &out) const noexcept(false) = 0;
+		// per-line failure probabilities of a repeated run, by noise level, and the lines failing most
+		virtual void serializeRepeats(const RepeatStatistics &repeats, IOutputSink &out) const noexcept(false) = 0;
+		// rounds of a threshold sweep and the bracket it ended with
+		virtual void serializeSweep(const ThresholdSweep &sweep, IOutputSink &out) const noexcept(false) = 0;
+		// one line 'flips bits log_ratio' per test, the weights of a biased run
+		virtual void serializeLikelihoods(const std::vector<NoiseLikelihood> &likelihoods, IOutputSink &out) const noexcept(false) = 0;
+		// weighted failure rate estimates of a biased run, by noise level
+		virtual void serializeImportance(const ImportanceStatistics &importance, IOutputSink &out) const noexcept(false) = 0;
+		// A/B report: verdicts of both decoders side by side, then their paired statistics
+		virtual void serializeComparison(const nti::TestReport &a, const nti::TestReport &b, const PairedStatistics &paired,
+			IOutputSink &out) const noexcept(false) = 0;
 
 		virtual ~IChannelTesterSerialzer() = default;
 	};
@@ -21,6 +192,9 @@ namespace nti
 	public:
 		virtual std::vector<std::string> parseCoderOutput(const std::string &encode_decode) const = 0;
 		virtual std::vector<UserTestInput> parseInput(const std::string &input) const = 0;
+		virtual UserTestInput parseInputLine(const std::string &line) const = 0;
+		virtual LineIndex parseIndex(const std::string &raw) const noexcept(false) = 0;
+		virtual NoiseLikelihood parseLikelihoodLine(const std::string &line) const noexcept(false) = 0;
 
 		virtual ~IChannelTesterParser() = default;
 	};
@@ -30,13 +204,28 @@ namespace nti
 	public:
 		std::vector<std::string> parseCoderOutput(const std::string &encode_decode) const override;
 		std::vector<UserTestInput> parseInput(const std::string& input) const override;
+		UserTestInput parseInputLine(const std::string &line) const override;
+		LineIndex parseIndex(const std::string &raw) const noexcept(false) override;
+		NoiseLikelihood parseLikelihoodLine(const std::string &line) const noexcept(false) override;
 	};
 
 	class IChannelTesterWriter
 	{
 	public:
+		// '-' stands for stdin/stdout
+		virtual std::shared_ptr<std::istream> openInput(const std::string &path) const noexcept(false) = 0;
+		virtual std::shared_ptr<std::ostream> openOutput(const std::string &path) const noexcept(false) = 0;
+		virtual std::unique_ptr<IOutputSink> openSink(const std::string &path) const noexcept(false) = 0;
+		// nullptr if 'path' can't be written at offsets (stdout, pipes, platforms without pwrite)
+		virtual std::unique_ptr<IPositionedOutput> openPositioned(const std::string &path) const noexcept(false) = 0;
+
 		virtual void toFile(const std::string &path, const std::string &data) const noexcept(false) = 0;
 		virtual std::string fromFile(const std::string &path) const noexcept(false) = 0;
+		// reads given [offset, offset+size) ranges of a file
+		virtual std::vector<std::string> fromFile(const std::string &path, const std::vector<std::pair<uint64_t, uint64_t>> &ranges) const noexcept(false) = 0;
+		virtual bool exists(const std::string &path) const noexcept = 0;
+		// size and modification time (seconds) of a regular file, false if there is no such file
+		virtual bool fileStat(const std::string &path, uint64_t &size, uint64_t &mtime) const noexcept = 0;
 
 		virtual ~IChannelTesterWriter() = default;
 
@@ -47,8 +236,18 @@ namespace nti
 
 	
 	public:
+		static const std::string STD_STREAM;
+
+		std::shared_ptr<std::istream> openInput(const std::string &path) const noexcept(false) override;
+		std::shared_ptr<std::ostream> openOutput(const std::string &path) const noexcept(false) override;
+		std::unique_ptr<IOutputSink> openSink(const std::string &path) const noexcept(false) override;
+		std::unique_ptr<IPositionedOutput> openPositioned(const std::string &path) const noexcept(false) override;
+
 		void toFile(const std::string& path, const std::string& data) const noexcept(false) override;
 		std::string fromFile(const std::string& path) const noexcept(false) override;
+		std::vector<std::string> fromFile(const std::string &path, const std::vector<std::pair<uint64_t, uint64_t>> &ranges) const noexcept(false) override;
+		bool exists(const std::string &path) const noexcept override;
+		bool fileStat(const std::string &path, uint64_t &size, uint64_t &mtime) const noexcept override;
 		
 		static std::unique_ptr<std::fstream> SafeOpen(const std::string &path, int open_mode = std::ios_base::out | std::ios_base::in) noexcept(false);
 	};
@@ -58,8 +257,30 @@ namespace nti
 	{
 	public:
 		std::string serializeData(const std::vector<UserTestInput> &data) const override;
+		size_t serializedSize(const std::vector<UserTestInput> &data) const override;
+		char *serializeData(const std::vector<UserTestInput> &data, char *out) const override;
+		void serializeData(const std::vector<UserTestInput> &data, IOutputSink &out) const noexcept(false) override;
+		LineIndex indexData(const std::vector<UserTestInput> &data, uint64_t base_offset = 0) const override;
+		uint64_t serializeData(const std::vector<UserTestInput> &data, IPositionedOutput &out, uint64_t offset) const noexcept(false) override;
+
+		static const size_t SERIALIZE_CHUNK_RECORDS;
+		std::string serializeIndex(const LineIndex &index) const override;
+		// failed tests rendered at once: at most this many, and lines of at most this many bytes unless a single test has more
+		static const size_t REPORT_WINDOW_TESTS, REPORT_WINDOW_BYTES;
 		std::string serializeReport(const nti::TestReport& report, const std::vector<UserTestInput> &generated,
-			const std::vector<UserTestInput> &noised, const std::vector<std::string> &decoded) const override;
+			const std::vector<UserTestInput> &noised, const std::vector<std::string> &decoded, const ReportLayout &layout = ReportLayout()) const override;
+		void serializeReport(const nti::TestReport& report, const std::vector<UserTestInput> &generated,
+			const std::vector<UserTestInput> &noised, const std::vector<std::string> &decoded, IOutputSink &out,
+			const ReportLayout &layout = ReportLayout()) const noexcept(false) override;
+		void serializeHeatmap(const ErrorHeatmap &heatmap, IOutputSink &out) const noexcept(false) override;
+		void serializeEstimates(const SequentialEstimator &estimator, IOutputSink &out) const noexcept(false) override;
+		static const size_t REPORT_WORST_LINES;
+		void serializeRepeats(const RepeatStatistics &repeats, IOutputSink &out) const noexcept(false) override;
+		void serializeSweep(const ThresholdSweep &sweep, IOutputSink &out) const noexcept(false) override;
+		void serializeLikelihoods(const std::vector<NoiseLikelihood> &likelihoods, IOutputSink &out) const noexcept(false) override;
+		void serializeImportance(const ImportanceStatistics &importance, IOutputSink &out) const noexcept(false) override;
+		void serializeComparison(const nti::TestReport &a, const nti::TestReport &b, const PairedStatistics &paired,
+			IOutputSink &out) const noexcept(false) override;
 	};
 
 
@@ -0,0 +1,86 @@
+#include "hash.h"
+#include <cstring>
+
+namespace nti
+{
+	namespace
+	{
+		const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL, PRIME2 = 0xC2B2AE3D27D4EB4FULL, PRIME3 = 0x165667B19E3779F9ULL,
+			PRIME4 = 0x85EBCA77C2B2AE63ULL, PRIME5 = 0x27D4EB2F165667C5ULL;
+
+		inline uint64_t rotl_(uint64_t v, int r)
+		{
+			return (v << r) | (v >> (64 - r));
+		}
+
+		// unaligned little-endian loads
+		inline uint64_t read64_(const char *p)
+		{
+			uint64_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		inline uint32_t read32_(const char *p)
+		{
+			uint32_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		inline uint64_t round_(uint64_t acc, uint64_t input)
+		{
+			return rotl_(acc + input * PRIME2, 31) * PRIME1;
+		}
+
+		inline uint64_t merge_(uint64_t acc, uint64_t v)
+		{
+			return (acc ^ round_(0, v)) * PRIME1 + PRIME4;
+		}
+	}
+
+	uint64_t hash64(const char *data, size_t size, uint64_t seed)
+	{
+		const char *p = data, *end = data + size;
+		uint64_t h;
+		if (size >= 32)
+		{
+			// four independent lanes over 32-byte stripes
+			uint64_t v1 = seed + PRIME1 + PRIME2, v2 = seed + PRIME2, v3 = seed, v4 = seed - PRIME1;
+			for (const char *limit = end - 32; p <= limit; p += 32)
+			{
+				v1 = round_(v1, read64_(p));
+				v2 = round_(v2, read64_(p + 8));
+				v3 = round_(v3, read64_(p + 16));
+				v4 = round_(v4, read64_(p + 24));
+			}
+			h = rotl_(v1, 1) + rotl_(v2, 7) + rotl_(v3, 12) + rotl_(v4, 18);
+			h = merge_(h, v1);
+			h = merge_(h, v2);
+			h = merge_(h, v3);
+			h = merge_(h, v4);
+		}
+		else
+			h = seed + PRIME5;
+		h += size;
+
+		for (; p + 8 <= end; p += 8)
+			h = rotl_(h ^ round_(0, read64_(p)), 27) * PRIME1 + PRIME4;
+		if (p + 4 <= end)
+		{
+			h = rotl_(h ^ (uint64_t(read32_(p)) * PRIME1), 23) * PRIME2 + PRIME3;
+			p += 4;
+		}
+		for (; p < end; ++p)
+			h = rotl_(h ^ (uint64_t(static_cast<unsigned char>(*p)) * PRIME5), 11) * PRIME1;
+
+		// avalanche
+		h ^= h >> 33;
+		h *= PRIME2;
+		h ^= h >> 29;
+		h *= PRIME3;
+		h ^= h >> 32;
+		return h;
+	}
+
+}
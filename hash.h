@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+namespace nti
+{
+	// 64-bit content hash (XXH64), fast enough to run over every line of a corpus
+	uint64_t hash64(const char *data, size_t size, uint64_t seed = 0);
+
+	inline uint64_t hash64(const std::string &s, uint64_t seed = 0)
+	{
+		return hash64(s.data(), s.size(), seed);
+	}
+
+}
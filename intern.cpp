@@ -0,0 +1,28 @@
+#include "intern.h"
+#include "hash.h"
+#include <cstring>
+
+namespace nti
+{
+	size_t InternArena::intern(const char *data, size_t size, uint64_t hash)
+	{
+		// 64-bit collisions are rare but possible, so a hit is confirmed byte by byte
+		auto range = by_hash_.equal_range(hash);
+		for (auto it = range.first; it != range.second; ++it)
+			if (lengths_[it->second] == size && std::memcmp(this->data(it->second), data, size) == 0)
+				return it->second;
+
+		size_t id = offsets_.size();
+		offsets_.push_back(bytes_.size());
+		lengths_.push_back(size);
+		bytes_.append(data, size);
+		by_hash_.emplace(hash, id);
+		return id;
+	}
+
+	size_t InternArena::intern(const char *data, size_t size)
+	{
+		return intern(data, size, hash64(data, size));
+	}
+
+}
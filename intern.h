@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+namespace nti
+{
+	// Content-addressed string store: equal strings are kept once in a shared arena and are referred to by id.
+	// Ids are stable, the bytes themselves may move as the arena grows.
+	class InternArena
+	{
+		std::string bytes_; // every distinct string, back to back
+		std::vector<uint64_t> offsets_;
+		std::vector<size_t> lengths_;
+		std::unordered_multimap<uint64_t, size_t> by_hash_; // content hash -> id
+
+	public:
+		// id of a string equal to data[0..size), stored if it is new; 'hash' must be hash64() of it
+		size_t intern(const char *data, size_t size, uint64_t hash);
+		size_t intern(const char *data, size_t size);
+		size_t intern(const std::string &s) { return intern(s.data(), s.size()); }
+
+		const char *data(size_t id) const { return bytes_.data() + offsets_[id]; }
+		size_t length(size_t id) const { return lengths_[id]; }
+		std::string str(size_t id) const { return bytes_.substr(offsets_[id], lengths_[id]); }
+
+		size_t size() const { return offsets_.size(); } // distinct strings
+		size_t bytes() const { return bytes_.size(); }
+	};
+
+}
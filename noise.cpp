@@ -58,4 +58,49 @@ namespace nti
 		}
 		return nchar;
 	}
+
+	namespace
+	{
+		// splitmix64 finalizer, a bijection with full avalanche
+		inline uint64_t mix64_(uint64_t x)
+		{
+			x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+			return x ^ (x >> 31);
+		}
+	}
+
+	NTISeededNoise::NTISeededNoise(float probability, uint64_t seed, uint64_t stream) : probability_(probability), key_(mix64_(mix64_(seed) ^ stream))
+	{
+
+	}
+
+	void NTISeededNoise::seek(uint64_t position)
+	{
+		position_ = position;
+		attempt_ = 0;
+	}
+
+	byte NTISeededNoise::transform(byte chr) const
+	{
+		if (probability_ == 0)
+			return chr;
+		// 24 random bits per draw, compared like the uniform floats of NTINoise
+		const uint64_t threshold = uint64_t(double(probability_) * (1 << 24));
+		const uint64_t counter = mix64_(key_ + position_) + (uint64_t(attempt_++) << CHAR_BIT);
+		byte flips = 0;
+		for (unsigned i = 0; i < CHAR_BIT; ++i)
+			if ((mix64_(counter + i) >> 40) < threshold)
+			{
+				flips |= byte(1u << i);
+				++flips_;
+			}
+		bits_ += CHAR_BIT;
+		return chr ^ flips;
+	}
+
+	double NTISeededNoise::EffectiveProbability(float probability)
+	{
+		return double(uint64_t(double(probability) * (1 << 24))) / (1 << 24);
+	}
 }
@@ -2,6 +2,9 @@
 #include <vector>
 #include <memory>
 #include <random>
+#include <stdexcept>
+#include <cmath>
+#include <cstdint>
 
 namespace nti {
 
@@ -86,4 +89,27 @@ namespace nti {
 		byte transform(byte chr) const override;
 	};
 
+	// Counter-based noise: whether a bit flips depends only on (seed, stream, position, attempt, bit), so the same
+	// stream noises any data with the same error pattern - two codecs can be compared on identical channel realizations.
+	// Every 'transform' at a position is a new attempt, 'seek' moves to another position.
+	class NTISeededNoise : public INoise
+	{
+		float probability_;
+		uint64_t key_;
+		uint64_t position_ = { 0 };
+		mutable unsigned attempt_ = { 0 };
+		mutable uint64_t bits_ = { 0 }, flips_ = { 0 };
+	public:
+		NTISeededNoise(float probability, uint64_t seed, uint64_t stream);
+
+		void seek(uint64_t position);
+		byte transform(byte chr) const override;
+
+		// bits drawn by all 'transform' calls so far and how many of them flipped, redrawn attempts included
+		uint64_t bits() const { return bits_; }
+		uint64_t flips() const { return flips_; }
+		// probability a bit really flips with, 'probability' rounded down to the resolution of a draw
+		static double EffectiveProbability(float probability);
+	};
+
 }
@@ -0,0 +1,102 @@
+#include "retention.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace nti
+{
+	const size_t FailureRetention::NONE = size_t(-1);
+	const size_t FailureRetention::DEFAULT_LIMIT;
+	const uint64_t FailureRetention::DEFAULT_SEED = 0x5EED;
+
+	FailureRetention::FailureRetention(Policy policy, size_t limit, uint64_t seed) : policy_(policy), limit_(limit), rng_(seed)
+	{
+	}
+
+	size_t FailureRetention::offerWorst_(std::vector<size_t>& heap, const Candidate& candidate)
+	{
+		// the heap top is the kept candidate with fewest errors, ties keep the earlier test
+		auto greater = [this](size_t a, size_t b) { return kept_[a].errors > kept_[b].errors; };
+		if (heap.size() < limit_)
+		{
+			size_t slot = kept_.size();
+			kept_.push_back(candidate);
+			heap.push_back(slot);
+			std::push_heap(heap.begin(), heap.end(), greater);
+			return slot;
+		}
+		if (heap.empty() || kept_[heap.front()].errors >= candidate.errors)
+			return NONE;
+		std::pop_heap(heap.begin(), heap.end(), greater);
+		size_t slot = heap.back();
+		kept_[slot] = candidate;
+		std::push_heap(heap.begin(), heap.end(), greater);
+		return slot;
+	}
+
+	size_t FailureRetention::offer(const Candidate& candidate)
+	{
+		++offered_;
+		switch (policy_)
+		{
+		case Policy::FIRST:
+			break;
+		case Policy::RESERVOIR:
+			if (kept_.size() >= limit_)
+			{
+				// the n-th candidate replaces a random one with probability limit / n
+				auto j = std::uniform_int_distribution<size_t>(0, offered_ - 1)(rng_);
+				if (j >= limit_)
+					return NONE;
+				kept_[j] = candidate;
+				return j;
+			}
+			break;
+		case Policy::WORST:
+			if (heaps_.empty())
+				heaps_.emplace_back();
+			return offerWorst_(heaps_.front().second, candidate);
+		case Policy::PER_LEVEL:
+		{
+			auto it = std::lower_bound(heaps_.begin(), heaps_.end(), candidate.noise_level,
+				[](const std::pair<float, std::vector<size_t>> &h, float level) { return h.first < level; });
+			if (it == heaps_.end() || it->first != candidate.noise_level)
+				it = heaps_.insert(it, std::make_pair(candidate.noise_level, std::vector<size_t>()));
+			return offerWorst_(it->second, candidate);
+		}
+		}
+		if (kept_.size() >= limit_)
+			return NONE;
+		kept_.push_back(candidate);
+		return kept_.size() - 1;
+	}
+
+	size_t FailureRetention::capacity() const
+	{
+		return policy_ == Policy::PER_LEVEL ? limit_ * std::max<size_t>(1, heaps_.size()) : limit_;
+	}
+
+	FailureRetention::Policy FailureRetention::ParsePolicy(const std::string& name) noexcept(false)
+	{
+		for (auto p : { Policy::FIRST, Policy::RESERVOIR, Policy::WORST, Policy::PER_LEVEL })
+			if (PolicyName(p) == name)
+				return p;
+		throw std::runtime_error("[FailureRetention] Unknown retention policy '" + name + "'");
+	}
+
+	std::string FailureRetention::PolicyName(Policy policy)
+	{
+		switch (policy)
+		{
+		case Policy::FIRST:
+			return "first";
+		case Policy::RESERVOIR:
+			return "reservoir";
+		case Policy::WORST:
+			return "worst";
+		case Policy::PER_LEVEL:
+			return "per_level";
+		}
+		return "";
+	}
+
+}
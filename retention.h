@@ -0,0 +1,60 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdint>
+
+namespace nti
+{
+	// Decides which failed tests are kept for the report, so memory and report size stay bounded however many fail.
+	// Kept candidates live in slots; the owner keeps whatever it needs of a test (e.g. its lines) in a vector
+	// indexed by the slot 'offer' returns.
+	class FailureRetention
+	{
+	public:
+		enum class Policy
+		{
+			FIRST,     // first 'limit' failures
+			RESERVOIR, // uniform sample of 'limit' failures (algorithm R)
+			WORST,     // 'limit' failures with most errors
+			PER_LEVEL  // 'limit' failures with most errors of every noise level
+		};
+
+		struct Candidate
+		{
+			size_t test;
+			float noise_level;
+			size_t errors;
+		};
+
+		static const size_t NONE;
+		static const size_t DEFAULT_LIMIT = 1000;
+		static const uint64_t DEFAULT_SEED;
+
+		FailureRetention(Policy policy = Policy::FIRST, size_t limit = DEFAULT_LIMIT, uint64_t seed = DEFAULT_SEED);
+
+		// slot the candidate is kept in, possibly one of a candidate it replaces; NONE if it's dropped
+		size_t offer(const Candidate &candidate);
+
+		const std::vector<Candidate> &kept() const { return kept_; } // by slot
+		size_t offered() const { return offered_; }
+		Policy policy() const { return policy_; }
+		size_t limit() const { return limit_; }
+		// most candidates kept so far may grow to: 'limit', for PER_LEVEL 'limit' for every noise level offered
+		size_t capacity() const;
+
+		static Policy ParsePolicy(const std::string &name) noexcept(false);
+		static std::string PolicyName(Policy policy);
+	private:
+		Policy policy_;
+		size_t limit_;
+		size_t offered_ = { 0 };
+		std::vector<Candidate> kept_;
+		std::mt19937_64 rng_;
+		// min-heaps of slots by errors: one for WORST, one per noise level for PER_LEVEL
+		std::vector<std::pair<float, std::vector<size_t>>> heaps_;
+
+		size_t offerWorst_(std::vector<size_t> &heap, const Candidate &candidate);
+	};
+
+}
@@ -0,0 +1,623 @@
+#include "stats.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <limits>
+
+namespace nti
+{
+	void RunningStat::add(double x)
+	{
+		if (count_ == 0)
+			min_ = max_ = x;
+		else
+		{
+			min_ = std::min(min_, x);
+			max_ = std::max(max_, x);
+		}
+		++count_;
+		double delta = x - mean_;
+		mean_ += delta / count_;
+		m2_ += delta * (x - mean_);
+	}
+
+	void RunningStat::remove(double x)
+	{
+		if (count_ <= 1)
+		{
+			count_ = 0;
+			mean_ = m2_ = 0;
+			return;
+		}
+		double mean = (mean_ * count_ - x) / (count_ - 1);
+		m2_ = std::max(0.0, m2_ - (x - mean) * (x - mean_));
+		mean_ = mean;
+		--count_;
+	}
+
+	void RunningStat::merge(const RunningStat& other)
+	{
+		if (other.count_ == 0)
+			return;
+		if (count_ == 0)
+		{
+			*this = other;
+			return;
+		}
+		size_t count = count_ + other.count_;
+		double delta = other.mean_ - mean_;
+		mean_ += delta * other.count_ / count;
+		m2_ += other.m2_ + delta * delta * (double(count_) * other.count_ / count);
+		count_ = count;
+		min_ = std::min(min_, other.min_);
+		max_ = std::max(max_, other.max_);
+	}
+
+	double RunningStat::variance() const
+	{
+		return count_ < 2 ? 0 : m2_ / (count_ - 1);
+	}
+
+	double RunningStat::stddev() const
+	{
+		return std::sqrt(variance());
+	}
+
+	QuantileSketch::QuantileSketch(double unit) : unit_(unit)
+	{
+	}
+
+	size_t QuantileSketch::Bucket(uint64_t units)
+	{
+		const uint64_t sub = uint64_t(1) << SUB_BUCKET_BITS;
+		if (units < sub)
+			return size_t(units);
+		unsigned exp = SUB_BUCKET_BITS;
+		while (exp < 63 && units >> (exp + 1))
+			++exp;
+		return size_t((exp - SUB_BUCKET_BITS + 1) * sub + ((units >> (exp - SUB_BUCKET_BITS)) - sub));
+	}
+
+	double QuantileSketch::BucketValue(size_t bucket)
+	{
+		const size_t sub = size_t(1) << SUB_BUCKET_BITS;
+		if (bucket < sub)
+			return double(bucket);
+		unsigned shift = unsigned(bucket / sub - 1);
+		double low = double(uint64_t(sub + bucket % sub) << shift), width = double(uint64_t(1) << shift);
+		return low + (width - 1) / 2;
+	}
+
+	void QuantileSketch::add(double x)
+	{
+		x = std::max(0.0, x);
+		auto b = Bucket(uint64_t(std::min(x / unit_, 1.8e19)));
+		if (b >= counts_.size())
+			counts_.resize(b + 1);
+		++counts_[b];
+		max_ = count_++ ? std::max(max_, x) : x;
+	}
+
+	void QuantileSketch::remove(double x)
+	{
+		auto b = Bucket(uint64_t(std::min(std::max(0.0, x) / unit_, 1.8e19)));
+		if (b < counts_.size() && counts_[b])
+		{
+			--counts_[b];
+			--count_;
+		}
+	}
+
+	void QuantileSketch::merge(const QuantileSketch& other) noexcept(false)
+	{
+		if (other.unit_ != unit_)
+			throw std::runtime_error("[QuantileSketch::merge] Sketches of different units");
+		if (other.count_ == 0)
+			return;
+		if (other.counts_.size() > counts_.size())
+			counts_.resize(other.counts_.size());
+		for (size_t i = 0; i < other.counts_.size(); ++i)
+			counts_[i] += other.counts_[i];
+		max_ = count_ ? std::max(max_, other.max_) : other.max_;
+		count_ += other.count_;
+	}
+
+	double QuantileSketch::quantile(double q) const
+	{
+		if (count_ == 0)
+			return 0;
+		auto rank = std::max<uint64_t>(1, uint64_t(std::ceil(q * count_)));
+		uint64_t seen = 0;
+		for (size_t b = 0; b < counts_.size(); ++b)
+			if ((seen += counts_[b]) >= rank)
+				return std::min(max_, BucketValue(b) * unit_);
+		return max_;
+	}
+
+	DistinctCounter::DistinctCounter() : registers_(size_t(1) << PRECISION)
+	{
+	}
+
+	void DistinctCounter::add(uint64_t hash)
+	{
+		// first bits pick the register, it keeps the longest run of leading zeros (+1) of the rest
+		size_t reg = size_t(hash >> (64 - PRECISION));
+		uint64_t rest = hash << PRECISION;
+		uint8_t rank = 1;
+		while (rank <= 64 - PRECISION && !(rest & (uint64_t(1) << 63)))
+		{
+			++rank;
+			rest <<= 1;
+		}
+		registers_[reg] = std::max(registers_[reg], rank);
+	}
+
+	void DistinctCounter::merge(const DistinctCounter& other)
+	{
+		for (size_t i = 0; i < registers_.size(); ++i)
+			registers_[i] = std::max(registers_[i], other.registers_[i]);
+	}
+
+	double DistinctCounter::estimate() const
+	{
+		const double m = double(registers_.size());
+		double sum = 0;
+		size_t zeros = 0;
+		for (auto r : registers_)
+		{
+			sum += std::ldexp(1.0, -int(r));
+			zeros += r == 0;
+		}
+		double e = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+		// small cardinalities are counted much better by the empty registers (linear counting)
+		if (e <= 2.5 * m && zeros)
+			e = m * std::log(m / zeros);
+		return e;
+	}
+
+	void BucketStats::merge(const BucketStats& other)
+	{
+		rate.merge(other.rate);
+		success.merge(other.success);
+		residual_errors.merge(other.residual_errors);
+		residual_ber.merge(other.residual_ber);
+		channel_ber.merge(other.channel_ber);
+		residual_ber_quantiles.merge(other.residual_ber_quantiles);
+		num_failed += other.num_failed;
+	}
+
+	size_t TestStatistics::LengthBucket(size_t length)
+	{
+		size_t bucket = 0;
+		while (length > 1 && bucket + 1 < LENGTH_BUCKETS)
+		{
+			length >>= 1;
+			++bucket;
+		}
+		return bucket;
+	}
+
+	BucketStats& TestStatistics::noiseBucket_(float noise_level)
+	{
+		// kept sorted; a run has only a handful of noise levels
+		auto it = std::lower_bound(by_noise_.begin(), by_noise_.end(), noise_level,
+			[](const std::pair<float, BucketStats> &b, float l) { return b.first < l; });
+		if (it == by_noise_.end() || it->first != noise_level)
+			it = by_noise_.insert(it, std::make_pair(noise_level, BucketStats()));
+		return it->second;
+	}
+
+	void TestStatistics::addEncoded(float noise_level, size_t source_length, size_t encoded_length, uint64_t source_hash)
+	{
+		double rate = static_cast<double>(source_length) / encoded_length;
+		for (auto b : { &overall_, &noiseBucket_(noise_level), &by_length_[LengthBucket(source_length)] })
+			b->rate.add(rate);
+		if (source_length)
+			distributions_.expansion.add(static_cast<double>(encoded_length) / source_length);
+		distributions_.source_length.add(double(source_length));
+		distributions_.sources.add(source_hash);
+	}
+
+	void TestStatistics::addDecoded(float noise_level, size_t source_length, const DecodeSample& sample)
+	{
+		for (auto b : { &overall_, &noiseBucket_(noise_level), &by_length_[LengthBucket(source_length)] })
+		{
+			b->success.add(sample.success ? 1 : 0);
+			b->residual_errors.add(double(sample.residual_errors));
+			b->residual_ber.add(sample.residual_ber);
+			b->residual_ber_quantiles.add(sample.residual_ber);
+			if (sample.channel_ber >= 0)
+				b->channel_ber.add(sample.channel_ber);
+			b->num_failed += !sample.success;
+		}
+		distributions_.residual_bits.add(double(sample.residual_bits));
+		distributions_.longest_burst.add(double(sample.longest_burst));
+	}
+
+	void TestStatistics::removeDecoded(float noise_level, size_t source_length, const DecodeSample& sample)
+	{
+		for (auto b : { &overall_, &noiseBucket_(noise_level), &by_length_[LengthBucket(source_length)] })
+		{
+			b->success.remove(sample.success ? 1 : 0);
+			b->residual_errors.remove(double(sample.residual_errors));
+			b->residual_ber.remove(sample.residual_ber);
+			b->residual_ber_quantiles.remove(sample.residual_ber);
+			if (sample.channel_ber >= 0)
+				b->channel_ber.remove(sample.channel_ber);
+			b->num_failed -= !sample.success;
+		}
+		distributions_.residual_bits.remove(double(sample.residual_bits));
+		distributions_.longest_burst.remove(double(sample.longest_burst));
+	}
+
+	void TestStatistics::merge(const TestStatistics& other)
+	{
+		overall_.merge(other.overall_);
+		distributions_.expansion.merge(other.distributions_.expansion);
+		distributions_.source_length.merge(other.distributions_.source_length);
+		distributions_.residual_bits.merge(other.distributions_.residual_bits);
+		distributions_.longest_burst.merge(other.distributions_.longest_burst);
+		distributions_.sources.merge(other.distributions_.sources);
+		for (const auto &b : other.by_noise_)
+			noiseBucket_(b.first).merge(b.second);
+		for (size_t i = 0; i < LENGTH_BUCKETS; ++i)
+			by_length_[i].merge(other.by_length_[i]);
+	}
+
+	const size_t PairedBucket::EXACT_DISCORDANT;
+
+	void PairedBucket::add(bool success_a, bool success_b, double ber_a, double ber_b)
+	{
+		if (success_a)
+			success_b ? ++both_passed : ++only_a;
+		else
+			success_b ? ++only_b : ++both_failed;
+		ber_difference.add(ber_a - ber_b);
+	}
+
+	void PairedBucket::merge(const PairedBucket& other)
+	{
+		both_passed += other.both_passed;
+		only_a += other.only_a;
+		only_b += other.only_b;
+		both_failed += other.both_failed;
+		ber_difference.merge(other.ber_difference);
+	}
+
+	double PairedBucket::mcnemarStatistic() const
+	{
+		const double discordant = double(only_a + only_b);
+		if (discordant == 0)
+			return 0;
+		double d = std::max(std::fabs(double(only_a) - double(only_b)) - 1, 0.0);
+		return d * d / discordant;
+	}
+
+	double PairedBucket::mcnemarPValue() const
+	{
+		const size_t n = only_a + only_b;
+		if (n == 0)
+			return 1;
+		if (n >= EXACT_DISCORDANT)
+			return std::erfc(std::sqrt(mcnemarStatistic() / 2)); // chi-square with one degree of freedom
+		// two-sided binomial test of the smaller count with p = 1/2
+		double tail = 0, term = std::pow(0.5, double(n)); // C(n, 0) / 2^n
+		for (size_t i = 0, k = std::min(only_a, only_b); i <= k; ++i)
+		{
+			tail += term;
+			term *= double(n - i) / double(i + 1);
+		}
+		return std::min(1.0, 2 * tail);
+	}
+
+	PairedBucket& PairedStatistics::noiseBucket_(float noise_level)
+	{
+		auto it = std::lower_bound(by_noise_.begin(), by_noise_.end(), noise_level,
+			[](const std::pair<float, PairedBucket> &b, float l) { return b.first < l; });
+		if (it == by_noise_.end() || it->first != noise_level)
+			it = by_noise_.insert(it, std::make_pair(noise_level, PairedBucket()));
+		return it->second;
+	}
+
+	void PairedStatistics::add(float noise_level, bool success_a, bool success_b, double ber_a, double ber_b)
+	{
+		overall_.add(success_a, success_b, ber_a, ber_b);
+		noiseBucket_(noise_level).add(success_a, success_b, ber_a, ber_b);
+	}
+
+	void PairedStatistics::merge(const PairedStatistics& other)
+	{
+		overall_.merge(other.overall_);
+		for (const auto &b : other.by_noise_)
+			noiseBucket_(b.first).merge(b.second);
+	}
+
+	const double SequentialEstimator::Z_95 = 1.959964;
+
+	SequentialEstimator::SequentialEstimator(const std::vector<float>& noise_levels, double threshold, double width, size_t max_tests, double z)
+		: threshold_(threshold), width_(width), z_(z), max_tests_(max_tests)
+	{
+		for (auto l : noise_levels)
+			levels_.push_back(Level{ l, 0, 0, 0, 1, Verdict::OPEN });
+	}
+
+	std::pair<double, double> SequentialEstimator::WilsonInterval(size_t successes, size_t tests, double z)
+	{
+		if (tests == 0)
+			return std::make_pair(0.0, 1.0);
+		const double n = double(tests), p = successes / n, z2 = z * z;
+		const double center = (p + z2 / (2 * n)) / (1 + z2 / n);
+		const double half = z / (1 + z2 / n) * std::sqrt(p * (1 - p) / n + z2 / (4 * n * n));
+		return std::make_pair(std::max(0.0, center - half), std::min(1.0, center + half));
+	}
+
+	void SequentialEstimator::add(float noise_level, bool success) noexcept(false)
+	{
+		auto it = std::find_if(levels_.begin(), levels_.end(), [noise_level](const Level &l) { return l.noise_level == noise_level; });
+		if (it == levels_.end())
+			throw std::runtime_error("[SequentialEstimator::add] Unknown noise level " + std::to_string(noise_level));
+		if (it->verdict != Verdict::OPEN)
+			throw std::runtime_error("[SequentialEstimator::add] Noise level " + std::to_string(noise_level) + " is already settled");
+		++it->tests;
+		it->successes += success;
+	}
+
+	void SequentialEstimator::decide()
+	{
+		for (auto &l : levels_)
+		{
+			if (l.verdict != Verdict::OPEN)
+				continue;
+			std::tie(l.low, l.high) = WilsonInterval(l.successes, l.tests, z_);
+			if (l.low >= threshold_)
+				l.verdict = Verdict::ABOVE;
+			else if (l.high < threshold_)
+				l.verdict = Verdict::BELOW;
+			else if (l.high - l.low <= width_)
+				l.verdict = Verdict::PRECISE;
+			else if (l.tests >= max_tests_)
+				l.verdict = Verdict::EXHAUSTED;
+		}
+	}
+
+	std::vector<float> SequentialEstimator::open() const
+	{
+		std::vector<float> ret;
+		for (const auto &l : levels_)
+			if (l.verdict == Verdict::OPEN)
+				ret.push_back(l.noise_level);
+		return ret;
+	}
+
+	const char* SequentialEstimator::VerdictName(Verdict verdict)
+	{
+		switch (verdict)
+		{
+		case Verdict::ABOVE: return "meets the threshold";
+		case Verdict::BELOW: return "below the threshold";
+		case Verdict::PRECISE: return "interval narrower than the target width";
+		case Verdict::EXHAUSTED: return "maximum number of tests reached";
+		default: return "open";
+		}
+	}
+
+	RepeatStatistics::RepeatStatistics(size_t repeat, size_t worst_lines) : repeat_(repeat), worst_lines_(worst_lines)
+	{
+
+	}
+
+	void RepeatStatistics::add(size_t line, float noise_level, bool success) noexcept(false)
+	{
+		if (variants_ > 0 && line != line_)
+			throw std::runtime_error("[RepeatStatistics::add] Line " + std::to_string(line) + " came before all " + std::to_string(repeat_) +
+				" variants of line " + std::to_string(line_));
+		if (variants_ == 0)
+		{
+			line_ = line;
+			noise_level_ = noise_level;
+		}
+		failures_ += !success;
+		if (++variants_ == repeat_)
+			closeLine_();
+	}
+
+	bool RepeatStatistics::Worse(const Line &a, const Line &b)
+	{
+		return a.failures > b.failures || (a.failures == b.failures && a.line < b.line);
+	}
+
+	void RepeatStatistics::closeLine_()
+	{
+		auto level = std::find_if(levels_.begin(), levels_.end(), [this](const Level_ &l) { return l.noise_level == noise_level_; });
+		if (level == levels_.end())
+			level = levels_.insert(levels_.end(), Level_{ noise_level_, 0, 0, RunningStat() });
+		level->never_failed += failures_ == 0;
+		level->always_failed += failures_ == repeat_;
+		level->failure.add(double(failures_) / repeat_);
+		++lines_;
+
+		Line closed{ line_, noise_level_, failures_, 0, 0 };
+		if (failures_ > 0 && worst_lines_ > 0 && (worst_.size() < worst_lines_ || Worse(closed, worst_.front())))
+		{
+			std::tie(closed.low, closed.high) = SequentialEstimator::WilsonInterval(failures_, repeat_, SequentialEstimator::Z_95);
+			if (worst_.size() == worst_lines_)
+			{
+				std::pop_heap(worst_.begin(), worst_.end(), Worse);
+				worst_.pop_back();
+			}
+			worst_.push_back(closed);
+			std::push_heap(worst_.begin(), worst_.end(), Worse);
+		}
+		variants_ = failures_ = 0;
+	}
+
+	RepeatStatistics::Summary RepeatStatistics::Summarize(float noise_level, size_t lines, size_t never_failed, size_t always_failed, const RunningStat &failure)
+	{
+		Summary ret{ noise_level, lines, never_failed, always_failed, failure.mean(), 0, 0 };
+		// lines are the independent units, their variants share the source and the encoding
+		double half = failure.count() > 1 ? SequentialEstimator::Z_95 * failure.stddev() / std::sqrt(double(failure.count())) : 0;
+		ret.low = std::max(0.0, ret.mean_failure - half);
+		ret.high = std::min(1.0, ret.mean_failure + half);
+		return ret;
+	}
+
+	RepeatStatistics::Summary RepeatStatistics::overall() const
+	{
+		size_t never_failed = 0, always_failed = 0;
+		RunningStat failure;
+		for (const auto &l : levels_)
+		{
+			never_failed += l.never_failed;
+			always_failed += l.always_failed;
+			failure.merge(l.failure);
+		}
+		return Summarize(0, lines_, never_failed, always_failed, failure);
+	}
+
+	std::vector<RepeatStatistics::Summary> RepeatStatistics::byNoiseLevel() const
+	{
+		std::vector<Summary> ret;
+		for (const auto &l : levels_)
+			ret.push_back(Summarize(l.noise_level, l.failure.count(), l.never_failed, l.always_failed, l.failure));
+		std::sort(ret.begin(), ret.end(), [](const Summary &a, const Summary &b) { return a.noise_level < b.noise_level; });
+		return ret;
+	}
+
+	std::vector<RepeatStatistics::Line> RepeatStatistics::worst(size_t count) const
+	{
+		auto ret = worst_;
+		std::sort(ret.begin(), ret.end(), Worse);
+		if (ret.size() > count)
+			ret.resize(count);
+		return ret;
+	}
+
+	ThresholdSweep::ThresholdSweep(float low, float high, float precision, size_t candidates, double threshold)
+		: low_(low), high_(high), precision_(precision), candidates_(candidates), threshold_(threshold)
+	{
+
+	}
+
+	std::vector<float> ThresholdSweep::next() const
+	{
+		std::vector<float> ret;
+		if (outcome_ != Outcome::SEARCHING)
+			return ret;
+		if (rounds_.empty())
+			ret.push_back(low_);
+		for (size_t i = 1; i <= candidates_; ++i)
+			ret.push_back(low_ + (high_ - low_) * i / (candidates_ + 1));
+		if (rounds_.empty())
+			ret.push_back(high_);
+		return ret;
+	}
+
+	void ThresholdSweep::record(const std::vector<float>& levels, const std::vector<size_t>& tests, const std::vector<size_t>& successes) noexcept(false)
+	{
+		if (levels != next() || tests.size() != levels.size() || successes.size() != levels.size())
+			throw std::runtime_error("[ThresholdSweep::record] Results do not match the levels of the round");
+		std::vector<Point> round;
+		for (size_t i = 0; i < levels.size(); ++i)
+			round.push_back(Point{ levels[i], tests[i], successes[i], tests[i] > 0 && double(successes[i]) / tests[i] >= threshold_ });
+		const bool first = rounds_.empty();
+		rounds_.push_back(round);
+
+		if (first)
+		{
+			if (!round.front().passed)
+			{
+				outcome_ = Outcome::BELOW_RANGE;
+				return;
+			}
+			if (round.back().passed)
+			{
+				outcome_ = Outcome::ABOVE_RANGE;
+				return;
+			}
+			round.erase(round.begin());
+			round.pop_back();
+		}
+		// the bracket narrows to the gap before the first failing level
+		float low = low_, high = high_;
+		for (const auto &p : round)
+		{
+			if (!p.passed)
+			{
+				high = p.noise_level;
+				break;
+			}
+			low = p.noise_level;
+		}
+		low_ = low;
+		high_ = high;
+		if (high_ - low_ <= precision_)
+			outcome_ = Outcome::FOUND;
+	}
+
+	const char* ThresholdSweep::OutcomeName(Outcome outcome)
+	{
+		switch (outcome)
+		{
+		case Outcome::FOUND: return "found";
+		case Outcome::BELOW_RANGE: return "below the range, its lowest level fails";
+		case Outcome::ABOVE_RANGE: return "above the range, its highest level passes";
+		default: return "searching";
+		}
+	}
+
+	void ImportanceBucket::add(bool failed, double log_ratio)
+	{
+		++tests;
+		if (!failed)
+		{
+			weighted.add(0);
+			return;
+		}
+		++failures;
+		double w = std::exp(log_ratio);
+		weighted.add(w);
+		failure_weight_squares += w * w;
+	}
+
+	double ImportanceBucket::standardError() const
+	{
+		return tests > 1 ? weighted.stddev() / std::sqrt(double(tests)) : 0;
+	}
+
+	double ImportanceBucket::relativeError() const
+	{
+		return estimate() > 0 ? standardError() / estimate() : 0;
+	}
+
+	double ImportanceBucket::effectiveFailures() const
+	{
+		double sum = estimate() * tests;
+		return failure_weight_squares > 0 ? sum * sum / failure_weight_squares : 0;
+	}
+
+	void ImportanceStatistics::add(float noise_level, bool failed, double log_ratio)
+	{
+		overall_.add(failed, log_ratio);
+		auto it = std::lower_bound(by_noise_.begin(), by_noise_.end(), noise_level,
+			[](const std::pair<float, ImportanceBucket> &b, float l) { return b.first < l; });
+		if (it == by_noise_.end() || it->first != noise_level)
+			it = by_noise_.insert(it, std::make_pair(noise_level, ImportanceBucket()));
+		it->second.add(failed, log_ratio);
+	}
+
+	double ImportanceStatistics::LogLikelihoodRatio(uint64_t flips, uint64_t bits, double nominal, double biased)
+	{
+		// a flip the nominal channel cannot make has no weight at all
+		if (flips > 0 && nominal <= 0)
+			return -std::numeric_limits<double>::infinity();
+		double ret = 0;
+		if (flips > 0)
+			ret += flips * std::log(nominal / biased);
+		if (bits > flips)
+			ret += (bits - flips) * std::log1p(-nominal) - (bits - flips) * std::log1p(-biased);
+		return ret;
+	}
+
+}
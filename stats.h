@@ -0,0 +1,329 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace nti
+{
+	// Numerically stable running mean and variance (Welford), O(1) per update, mergeable (Chan et al.)
+	class RunningStat
+	{
+		size_t count_ = { 0 };
+		double mean_ = { 0 }, m2_ = { 0 }, min_ = { 0 }, max_ = { 0 };
+	public:
+		void add(double x);
+		// takes back a value added before; min/max keep covering it
+		void remove(double x);
+		void merge(const RunningStat &other);
+
+		size_t count() const { return count_; }
+		double mean() const { return mean_; }
+		double variance() const; // sample variance, 0 for less than two values
+		double stddev() const;
+		double min() const { return min_; }
+		double max() const { return max_; }
+	};
+
+	// HDR-histogram style quantile sketch: exact below 2^SUB_BUCKET_BITS units, above that every power of two
+	// is split into 2^SUB_BUCKET_BITS linear buckets, so quantiles are within 1/32 relative error.
+	// Memory depends on the range of values only; sketches with the same unit merge exactly.
+	class QuantileSketch
+	{
+		double unit_;
+		std::vector<uint64_t> counts_;
+		uint64_t count_ = { 0 };
+		double max_ = { 0 };
+
+		static size_t Bucket(uint64_t units);
+		static double BucketValue(size_t bucket); // middle of the bucket, in units
+	public:
+		static const unsigned SUB_BUCKET_BITS = 5;
+
+		explicit QuantileSketch(double unit = 1); // smallest distinguishable value, negative values count as 0
+
+		void add(double x);
+		// takes back a value added before; max keeps covering it
+		void remove(double x);
+		void merge(const QuantileSketch &other) noexcept(false);
+
+		uint64_t count() const { return count_; }
+		double max() const { return max_; }
+		// value at rank ceil(q * count), 0 for an empty sketch
+		double quantile(double q) const;
+	};
+
+	// HyperLogLog distinct counter over 64-bit hashes: 2^PRECISION registers, about 1.6% standard error
+	class DistinctCounter
+	{
+		std::vector<uint8_t> registers_;
+	public:
+		static const unsigned PRECISION = 12;
+
+		DistinctCounter();
+
+		void add(uint64_t hash);
+		void merge(const DistinctCounter &other);
+		double estimate() const;
+	};
+
+	// Statistics of a group of tests
+	struct BucketStats
+	{
+		RunningStat rate;            // source size / encoded size, for every encoded test
+		RunningStat success;         // 1 - passed, 0 - failed, for every decoded test
+		RunningStat residual_errors; // mismatching characters
+		RunningStat residual_ber;    // residual bit error rate
+		RunningStat channel_ber;     // realized channel bit error rate, if noised data is known
+		QuantileSketch residual_ber_quantiles = QuantileSketch(1e-7);
+		size_t num_failed = { 0 };
+
+		void merge(const BucketStats &other);
+	};
+
+	// Statistics engine of the tester: overall, by noise level and by log2 of the source length.
+	// Every update is O(1); instances filled by different threads are merged afterwards.
+	class TestStatistics
+	{
+	public:
+		static const size_t LENGTH_BUCKETS = 33;
+
+		// what is known of a test once it's decoded
+		struct DecodeSample
+		{
+			bool success;
+			size_t residual_errors;
+			size_t residual_bits;
+			size_t longest_burst; // of mismatching characters
+			double residual_ber;
+			double channel_ber; // negative if unknown
+		};
+
+		// distributions over all tests, kept as sketches
+		struct Distributions
+		{
+			QuantileSketch expansion = QuantileSketch(1.0 / 1024); // encoded size / source size
+			QuantileSketch source_length;
+			QuantileSketch residual_bits;
+			QuantileSketch longest_burst;
+			DistinctCounter sources;
+		};
+
+		void addEncoded(float noise_level, size_t source_length, size_t encoded_length, uint64_t source_hash);
+		void addDecoded(float noise_level, size_t source_length, const DecodeSample &sample);
+		void removeDecoded(float noise_level, size_t source_length, const DecodeSample &sample);
+		void merge(const TestStatistics &other);
+
+		const BucketStats &overall() const { return overall_; }
+		const Distributions &distributions() const { return distributions_; }
+		// sorted by noise level
+		const std::vector<std::pair<float, BucketStats>> &byNoiseLevel() const { return by_noise_; }
+		// bucket 'k' holds sources with length in [2^k, 2^(k+1)), bucket 0 also holds empty ones
+		const std::array<BucketStats, LENGTH_BUCKETS> &byLength() const { return by_length_; }
+
+		static size_t LengthBucket(size_t length);
+	private:
+		BucketStats overall_;
+		Distributions distributions_;
+		std::vector<std::pair<float, BucketStats>> by_noise_;
+		std::array<BucketStats, LENGTH_BUCKETS> by_length_;
+
+		BucketStats &noiseBucket_(float noise_level);
+	};
+
+	// Two decoders checked on the same tests: how often only one of them passes and how their residual BERs differ
+	struct PairedBucket
+	{
+		// below this many discordant tests McNemar's test is exact (binomial), above it uses chi-square
+		static const size_t EXACT_DISCORDANT = 50;
+
+		size_t both_passed = { 0 }, only_a = { 0 }, only_b = { 0 }, both_failed = { 0 };
+		RunningStat ber_difference; // residual BER of A minus that of B, per test
+
+		void add(bool success_a, bool success_b, double ber_a, double ber_b);
+		void merge(const PairedBucket &other);
+
+		size_t count() const { return both_passed + only_a + only_b + both_failed; }
+		// chi-square with continuity correction, (|only_a - only_b| - 1)^2 / (only_a + only_b)
+		double mcnemarStatistic() const;
+		// two-sided p-value of 'both decoders fail equally often'
+		double mcnemarPValue() const;
+	};
+
+	// paired statistics overall and by noise level
+	class PairedStatistics
+	{
+		PairedBucket overall_;
+		std::vector<std::pair<float, PairedBucket>> by_noise_;
+
+		PairedBucket &noiseBucket_(float noise_level);
+	public:
+		void add(float noise_level, bool success_a, bool success_b, double ber_a, double ber_b);
+		void merge(const PairedStatistics &other);
+
+		const PairedBucket &overall() const { return overall_; }
+		// sorted by noise level
+		const std::vector<std::pair<float, PairedBucket>> &byNoiseLevel() const { return by_noise_; }
+	};
+
+	// Sequential test allocation: tests go to the noise levels whose success rate is still open. A level is settled once
+	// the Wilson score interval of its success rate lies on one side of the threshold, gets narrower than the target
+	// width, or the level has had the maximum number of tests.
+	class SequentialEstimator
+	{
+	public:
+		static const double Z_95; // two-sided 95% confidence
+
+		enum class Verdict { OPEN, ABOVE, BELOW, PRECISE, EXHAUSTED };
+		struct Level
+		{
+			float noise_level;
+			size_t tests, successes;
+			double low, high; // Wilson interval of the success rate, [0, 1] before any test
+			Verdict verdict;
+		};
+
+		SequentialEstimator(const std::vector<float> &noise_levels, double threshold, double width, size_t max_tests, double z = Z_95);
+
+		// only counts the test, verdicts are given by decide() once the whole round is in
+		void add(float noise_level, bool success) noexcept(false);
+		// settles the open levels by their intervals; a settled level keeps both its verdict and its interval
+		void decide();
+		// levels which need more tests
+		std::vector<float> open() const;
+		const std::vector<Level> &levels() const { return levels_; }
+		double threshold() const { return threshold_; }
+
+		static std::pair<double, double> WilsonInterval(size_t successes, size_t tests, double z);
+		static const char *VerdictName(Verdict verdict);
+	private:
+		double threshold_, width_, z_;
+		size_t max_tests_;
+		std::vector<Level> levels_;
+	};
+
+	// Monte Carlo repetition: every source line is checked on 'repeat' noise realizations of the same encoding. Failures
+	// are counted per line, the spread of the per-line failure probabilities across lines gives the confidence interval.
+	// Variants of a line come one after another, a line is folded into its noise level once the last of them is in;
+	// only the worst lines are kept, so memory does not grow with the number of lines.
+	class RepeatStatistics
+	{
+	public:
+		struct Summary
+		{
+			float noise_level;
+			size_t lines, never_failed, always_failed;
+			double mean_failure, low, high; // mean per-line failure probability and its 95% interval
+		};
+		struct Line
+		{
+			size_t line;
+			float noise_level;
+			size_t failures;
+			double low, high; // Wilson interval of the failure probability of the line
+		};
+
+		RepeatStatistics(size_t repeat, size_t worst_lines);
+
+		void add(size_t line, float noise_level, bool success) noexcept(false);
+
+		size_t repeat() const { return repeat_; }
+		size_t lines() const { return lines_; }
+		Summary overall() const;
+		// sorted by noise level
+		std::vector<Summary> byNoiseLevel() const;
+		// lines with most failures, most first; no more than the worst lines kept
+		std::vector<Line> worst(size_t count) const;
+	private:
+		struct Level_
+		{
+			float noise_level;
+			size_t never_failed, always_failed;
+			RunningStat failure; // per-line failure probabilities
+		};
+
+		size_t repeat_, worst_lines_, lines_ = { 0 };
+		// the line whose variants are being counted
+		size_t line_ = { 0 }, variants_ = { 0 }, failures_ = { 0 };
+		float noise_level_ = { 0 };
+		std::vector<Level_> levels_;
+		std::vector<Line> worst_; // heap, the least failing line on top
+
+		void closeLine_();
+		static bool Worse(const Line &a, const Line &b);
+		static Summary Summarize(float noise_level, size_t lines, size_t never_failed, size_t always_failed, const RunningStat &failure);
+	};
+
+	// Search of the highest noise level at which the success rate still meets the threshold, by k-section of a bracket:
+	// every round checks 'candidates' levels evenly spaced inside it and narrows it to the gap where they turn from
+	// passing to failing. The first round also checks both ends. Success is assumed to fall as the noise grows.
+	class ThresholdSweep
+	{
+	public:
+		enum class Outcome { SEARCHING, FOUND, BELOW_RANGE, ABOVE_RANGE };
+		struct Point
+		{
+			float noise_level;
+			size_t tests, successes;
+			bool passed;
+		};
+
+		ThresholdSweep(float low, float high, float precision, size_t candidates, double threshold);
+
+		// levels to check in the next round, empty once the search is over
+		std::vector<float> next() const;
+		// tests of the levels of a round, in the order 'next' gave them
+		void record(const std::vector<float> &levels, const std::vector<size_t> &tests, const std::vector<size_t> &successes) noexcept(false);
+
+		Outcome outcome() const { return outcome_; }
+		// the threshold lies in [low, high) when the search is FOUND
+		float low() const { return low_; }
+		float high() const { return high_; }
+		double threshold() const { return threshold_; }
+		const std::vector<std::vector<Point>> &rounds() const { return rounds_; }
+
+		static const char *OutcomeName(Outcome outcome);
+	private:
+		float low_, high_, precision_;
+		size_t candidates_;
+		double threshold_;
+		Outcome outcome_ = { Outcome::SEARCHING };
+		std::vector<std::vector<Point>> rounds_;
+	};
+
+	// Importance sampling: tests noised with a higher (biased) flip probability than the nominal one, every test weighted
+	// by its likelihood ratio, nominal over biased. The mean of weight * failed is an unbiased estimate of the nominal
+	// failure rate, even one far too low to be seen by plain sampling.
+	struct ImportanceBucket
+	{
+		size_t tests = { 0 }, failures = { 0 };
+		RunningStat weighted;  // weight * failed, per test
+		double failure_weight_squares = { 0 }; // sum of squared weights of failed tests
+
+		void add(bool failed, double log_ratio);
+
+		double estimate() const { return weighted.mean(); }
+		double standardError() const;
+		// standard error over the estimate, 0 without failures
+		double relativeError() const;
+		// failures an unweighted sample with the same spread of weights would be worth, (sum w)^2 / sum w^2
+		double effectiveFailures() const;
+	};
+
+	class ImportanceStatistics
+	{
+		ImportanceBucket overall_;
+		std::vector<std::pair<float, ImportanceBucket>> by_noise_;
+	public:
+		void add(float noise_level, bool failed, double log_ratio);
+
+		const ImportanceBucket &overall() const { return overall_; }
+		// sorted by noise level
+		const std::vector<std::pair<float, ImportanceBucket>> &byNoiseLevel() const { return by_noise_; }
+
+		// log of the likelihood ratio of 'flips' flipped out of 'bits' drawn, nominal over biased flip probability
+		static double LogLikelihoodRatio(uint64_t flips, uint64_t bits, double nominal, double biased);
+	};
+
+}
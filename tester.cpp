@@ -1,6 +1,8 @@
 #include "tester.h"
 #include <algorithm>
 #include "utils.h"
+#include "compare.h"
+#include "hash.h"
 #include "tests/catch.hpp"
 
 namespace nti
@@ -14,6 +16,9 @@ namespace nti
 		case FailReason::ENCODE_SPEED_LOW:
 			return "Encoding speed of '" + std::to_string(this->mean_encode_speed) + "' is too low. Consider using a different algorithms or less encoding characters per input character.";
 		case FailReason::DECODE_FAILURE_RATE_HIGH:
+			if (this->is_partial && this->num_total_tests)
+				return std::to_string(this->num_failed) + " of " + std::to_string(this->num_total_tests) + " tests have already failed, decode success rate cannot reach '" +
+					std::to_string(NTIChannelTester::THRESHOLD_SUCCESS_RATE) + "' any more. Check your algorithm for errors and make sure you are adapting to your noise level.";
 			return "Decode failure of '" + std::to_string(1 - this->mean_decode_success_rate) + "' rate is too high. Check your algorithm for errors and make sure you are adapting to your noise level.";
 		case FailReason::DECODE_FAILURE_MANY_ERRORS:
 			return "Decoding algorithm failed more than maximum number of times. Check your algorithm for errors. Check your algorithm for errors and make sure you are adapting to your noise level.";
@@ -25,58 +30,344 @@ namespace nti
 		IChannelTester::MODE_DECODE_STR = "decode",
 		IChannelTester::MODE_ENCODE_STR = "encode";
 	const size_t NTIChannelTester::THRESHOLD_FAILS = 2;
+	const size_t
+		NTIChannelTester::RETAINED_SAMPLE_BYTES = 256 << 20,
+		NTIChannelTester::MIN_SAMPLE_LINE_BYTES = 4 << 10;
 	const float 
 		NTIChannelTester::THRESHOLD_CALC_SPEED = 0.2f, 
 		NTIChannelTester::THRESHOLD_SUCCESS_RATE = 0.8f;
 
+	namespace
+	{
+		// draws again while the noised character would break the line format
+		char noise_char_(char val, const INoise &noise)
+		{
+			auto nval = char(noise.transform(val));
+			while (nval == '\r' || nval == '\n' || nval == ' ')
+				nval = char(noise.transform(val));
+			return nval;
+		}
+
+		// copies the window of at most 'window' bytes of every line, a quarter of it before the first mismatch
+		FailedSample sample_window_(size_t test, const UserTestInput &source, const UserTestInput &noised, const std::string &decoded, size_t window)
+		{
+			FailedSample ret{ test, UserTestInput{ source.mode, source.noise_level, std::string() }, UserTestInput{ noised.mode, noised.noise_level, std::string() },
+				std::string(), 0, false };
+			if (source.input.size() > window || noised.input.size() > window || decoded.size() > window)
+			{
+				auto src_end = source.input.begin() + std::min(source.input.size(), decoded.size());
+				size_t mismatch = std::mismatch(source.input.begin(), src_end, decoded.begin()).first - source.input.begin();
+				ret.offset = mismatch > window / 4 ? mismatch - window / 4 : 0;
+				ret.cut = true;
+			}
+			auto copy = [&](const std::string &line) { return ret.offset < line.size() ? line.substr(ret.offset, window) : std::string(); };
+			ret.source.input = copy(source.input);
+			ret.noised.input = copy(noised.input);
+			ret.decoded = copy(decoded);
+			return ret;
+		}
+
+		// cuts a kept sample down to a smaller window around the same first mismatch
+		void narrow_sample_(FailedSample &sample, size_t window)
+		{
+			auto narrowed = sample_window_(sample.test, sample.source, sample.noised, sample.decoded, window);
+			if (!narrowed.cut)
+				return;
+			narrowed.offset += sample.offset;
+			sample = std::move(narrowed);
+		}
+
+		// noises every character
+		template <typename Seek>
+		std::string noise_line_(const std::string &encoded, const INoise &noise, Seek seek)
+		{
+			std::string ret = encoded;
+			for (size_t k = 0; k < ret.size(); ++k)
+			{
+				seek(k);
+				ret[k] = noise_char_(ret[k], noise);
+			}
+			return ret;
+		}
+	}
+
 	std::vector<UserTestInput> NTIChannelTester::generateNoisedInputs(const std::vector<UserTestInput>& inputs, const std::vector<std::string> &encoded) const
 	{
 		std::vector<UserTestInput> ret;
 
 		for (size_t i = 0, s = inputs.size(); i<s; ++i)
 		{
-			std::string new_str = encoded[i];
-
 			NTINoiseProducer noise_producer(INoiseProducer::NoiseProducerSettings(inputs[i].noise_level));
 			auto noise = noise_producer.get();
-			std::transform(new_str.begin(), new_str.end(), new_str.begin(), [&noise](char val)
-			{
-				auto nval = char(noise->transform(val));
-				while (nval == '\r' || nval == '\n' || nval == ' ')
-					nval = char(noise->transform(val));
-				return nval;
-			});
-			ret.emplace_back(UserTestInput{ MODE_DECODE_STR, inputs[i].noise_level, new_str });
+			ret.emplace_back(UserTestInput{ MODE_DECODE_STR, inputs[i].noise_level, noise_line_(encoded[i], *noise, [](size_t) {}) });
 		}
 		return ret;
 	}
 
-	const NoisedData* NTIChannelTester::setAlgoEncodeResponse(const std::string& source, const std::string& response, float noise_level)
+	std::vector<UserTestInput> NTIChannelTester::generateNoisedInputs(const std::vector<UserTestInput>& inputs, const std::vector<std::string>& encoded,
+		uint64_t seed, size_t first_test) const
 	{
-		noised_responses_[source] = std::make_unique<NoisedData>(source, response, noise_level);
+		std::vector<UserTestInput> ret(inputs.size());
+		// every test has its own stream, so they are independent of each other and of the order they are noised in
+		parallel_for(inputs.size(), [&](size_t, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				INoiseProducer::NoiseProducerSettings settings(inputs[i].noise_level); // validates the level
+				NTISeededNoise noise(settings.noise_level, seed, first_test + i);
+				ret[i] = UserTestInput{ MODE_DECODE_STR, inputs[i].noise_level, noise_line_(encoded[i], noise, [&noise](size_t k) { noise.seek(k); }) };
+			}
+		});
+		return ret;
+	}
+
+	std::vector<UserTestInput> NTIChannelTester::generateNoisedRepeats(const std::vector<UserTestInput>& inputs, const std::vector<std::string>& encoded,
+		size_t repeat, uint64_t seed, size_t first_test) const
+	{
+		std::vector<UserTestInput> ret(inputs.size() * repeat);
+		parallel_for(inputs.size(), [&](size_t, size_t begin, size_t end)
+		{
+			std::vector<NTISeededNoise> noises;
+			for (size_t i = begin; i < end; ++i)
+			{
+				INoiseProducer::NoiseProducerSettings settings(inputs[i].noise_level); // validates the level
+				noises.clear();
+				for (size_t v = 0; v < repeat; ++v)
+				{
+					noises.emplace_back(settings.noise_level, seed, (first_test + i) * repeat + v);
+					ret[i * repeat + v] = UserTestInput{ MODE_DECODE_STR, inputs[i].noise_level, encoded[i] };
+				}
+				// all variants in one pass, each character of the encoding is read once
+				const auto &line = encoded[i];
+				for (size_t k = 0; k < line.size(); ++k)
+					for (size_t v = 0; v < repeat; ++v)
+					{
+						noises[v].seek(k);
+						ret[i * repeat + v].input[k] = noise_char_(line[k], noises[v]);
+					}
+			}
+		});
+		return ret;
+	}
+
+	std::vector<UserTestInput> NTIChannelTester::generateBiasedInputs(const std::vector<UserTestInput>& inputs, const std::vector<std::string>& encoded,
+		float bias, uint64_t seed, size_t first_test, std::vector<NoiseLikelihood>& likelihoods) const
+	{
+		std::vector<UserTestInput> ret(inputs.size());
+		likelihoods.assign(inputs.size(), NoiseLikelihood());
+		INoiseProducer::NoiseProducerSettings biased(bias); // validates the level
+		parallel_for(inputs.size(), [&](size_t, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				INoiseProducer::NoiseProducerSettings settings(inputs[i].noise_level);
+				NTISeededNoise noise(biased.noise_level, seed, first_test + i);
+				ret[i] = UserTestInput{ MODE_DECODE_STR, inputs[i].noise_level, noise_line_(encoded[i], noise, [&noise](size_t k) { noise.seek(k); }) };
+				// every draw counts, those redrawn too: the output is a function of all of them
+				auto &l = likelihoods[i];
+				l.flips = noise.flips();
+				l.bits = noise.bits();
+				l.log_ratio = ImportanceStatistics::LogLikelihoodRatio(l.flips, l.bits,
+					NTISeededNoise::EffectiveProbability(settings.noise_level), NTISeededNoise::EffectiveProbability(biased.noise_level));
+			}
+		});
+		return ret;
+	}
+
+	size_t NTIChannelTester::setAlgoEncodeResponse(const std::string& source, const std::string& response, float noise_level)
+	{
+		tests_.push_back(Test_{ sources_.intern(source), response, noise_level });
+		decode_responses_.emplace_back();
+		decoded_.push_back(false);
+		failed_.push_back(false);
+		measurements_.emplace_back();
 		// update speed
-		auto ns = noised_responses_.size();
-		auto this_speed = static_cast<float>(source.size()) / response.size() / ns;
-		if (noised_responses_.size() == 1)
-			calc_speed_ = this_speed;
-		else
-			calc_speed_ = calc_speed_ * (ns-1) / ns + this_speed;
-		return noised_responses_[source].get();
+		stats_.addEncoded(noise_level, source.size(), response.size(), hash64(source));
+		updateRates_();
+		return tests_.size() - 1;
+
+	}
 
+	TestStatistics::DecodeSample NTIChannelTester::decodeSample_(size_t test) const
+	{
+		const auto &t = tests_[test];
+		const auto &m = measurements_[test];
+		auto length = sources_.length(t.source);
+		return TestStatistics::DecodeSample{ !failed_[test], m.mismatches, m.residual_bits, m.longest_burst,
+			length == 0 ? 0 : m.residual_bits / (8.0 * length),
+			m.has_channel && !t.response.empty() ? m.channel_bits / (8.0 * t.response.size()) : -1 };
+	}
+
+	size_t NTIChannelTester::errors_(const CompareResult& cmp, const char *decoded, size_t decoded_size, const char *source, size_t source_size) const
+	{
+		// the positional count bounds the edit distance, so no band wider than it is needed
+		if (!edit_distance_ || cmp.mismatches <= 1)
+			return cmp.mismatches;
+		auto aligned = edit_distance(decoded, decoded_size, source, source_size, std::min(edit_distance_, cmp.mismatches - 1));
+		return aligned.within_band ? aligned.distance : cmp.mismatches;
 	}
 
-	void NTIChannelTester::setAlgoDecodeResponse(const NoisedData* noised_data, const std::string& response)
+	void NTIChannelTester::updateRates_()
 	{
-		decode_responses_[noised_data] = response;
+		calc_speed_ = static_cast<float>(stats_.overall().rate.mean());
+		calc_success_rate_ = static_cast<float>(stats_.overall().success.mean());
+	}
+
+	NTIChannelTester::Batch_ NTIChannelTester::measureBatch_(const std::vector<UserTestInput>& sources, const std::vector<UserTestInput>& noised,
+		const std::vector<std::string>& encoded, const std::vector<std::string>& decoded, const SourceFingerprints *fingerprints) const noexcept(false)
+	{
+		if (sources.size() != encoded.size() || sources.size() != decoded.size() || sources.size() != noised.size() ||
+			(fingerprints && (fingerprints->hashes.size() != sources.size() || fingerprints->matched.size() != sources.size())))
+			throw std::runtime_error("[setAlgoResponses] Batch sizes differ");
+		const size_t count = sources.size();
+		Batch_ ret(heatmap_.by_offset.size());
+		ret.measurements.resize(count);
+		ret.hashes.resize(count);
+
+		// every shard accumulates its own results, they are merged afterwards
+		std::vector<Batch_> shards(parallel_shards(count), Batch_(heatmap_.by_offset.size()));
+		parallel_for(count, [&](size_t shard, size_t begin, size_t end)
+		{
+			auto &acc = shards[shard];
+			for (size_t i = begin; i < end; ++i)
+			{
+				// a decoded line with the source's fingerprint is the source
+				bool matched = fingerprints && fingerprints->matched[i];
+				const auto &src = matched ? decoded[i] : sources[i].input;
+				auto cmp = matched ? CompareResult() : compare_lines(decoded[i], src);
+				auto &m = ret.measurements[i];
+				m.mismatches = errors_(cmp, decoded[i].data(), decoded[i].size(), src.data(), src.size());
+				m.residual_bits = cmp.bit_errors;
+				m.longest_burst = cmp.longest_burst;
+				m.channel_bits = compare_lines(noised[i].input, encoded[i]).bit_errors;
+				m.has_channel = true;
+				if (!cmp.equal())
+				{
+					acc.failed.push_back(i);
+					accumulate_errors(decoded[i], src, acc.heatmap);
+				}
+				acc.many_errors += m.mismatches > THRESHOLD_FAILS;
+				ret.hashes[i] = fingerprints ? fingerprints->hashes[i] : hash64(src);
+				acc.stats.addEncoded(sources[i].noise_level, src.size(), encoded[i].size(), ret.hashes[i]);
+				acc.stats.addDecoded(sources[i].noise_level, src.size(), TestStatistics::DecodeSample{ cmp.equal(), m.mismatches, cmp.bit_errors, cmp.longest_burst,
+					src.empty() ? 0 : cmp.bit_errors / (8.0 * src.size()),
+					encoded[i].empty() ? -1 : m.channel_bits / (8.0 * encoded[i].size()) });
+			}
+		});
+
+		for (const auto &acc : shards)
+		{
+			ret.failed.insert(ret.failed.end(), acc.failed.begin(), acc.failed.end());
+			ret.many_errors += acc.many_errors;
+			ret.stats.merge(acc.stats);
+			ret.heatmap.merge(acc.heatmap);
+		}
+		return ret;
+	}
+
+	void NTIChannelTester::addBatch_(const Batch_& batch)
+	{
+		num_failed_ += batch.failed.size();
+		num_many_errors_ += batch.many_errors;
+		num_decoded_ += batch.measurements.size();
+		last_batch_ = batch.measurements;
+		stats_.merge(batch.stats);
+		heatmap_.merge(batch.heatmap);
+		updateRates_();
+	}
+
+	size_t NTIChannelTester::setAlgoResponses(const std::vector<UserTestInput>& sources, const std::vector<UserTestInput>& noised,
+		const std::vector<std::string>& encoded, const std::vector<std::string>& decoded) noexcept(false)
+	{
+		auto batch = measureBatch_(sources, noised, encoded, decoded);
+		const size_t first = tests_.size(), count = sources.size();
+		// sources were hashed in parallel while measured, interning itself is sequential
+		tests_.reserve(first + count);
+		for (size_t i = 0; i < count; ++i)
+			tests_.push_back(Test_{ sources_.intern(sources[i].input.data(), sources[i].input.size(), batch.hashes[i]), encoded[i], sources[i].noise_level });
+		decode_responses_.insert(decode_responses_.end(), decoded.begin(), decoded.end());
+		decoded_.resize(first + count, true);
+		failed_.resize(first + count, false);
+		measurements_.insert(measurements_.end(), batch.measurements.begin(), batch.measurements.end());
+		for (auto f : batch.failed)
+			failed_[first + f] = true;
+		addBatch_(batch);
+		return first;
+	}
+
+	size_t NTIChannelTester::streamAlgoResponses(const std::vector<UserTestInput>& sources, const std::vector<UserTestInput>& noised,
+		const std::vector<std::string>& encoded, const std::vector<std::string>& decoded, const SourceFingerprints *fingerprints) noexcept(false)
+	{
+		auto batch = measureBatch_(sources, noised, encoded, decoded, fingerprints);
+		const size_t first = num_tests();
+		for (auto f : batch.failed)
+		{
+			// lines are copied only for the failures which are kept
+			auto slot = retention_.offer(FailureRetention::Candidate{ first + f, sources[f].noise_level, batch.measurements[f].mismatches });
+			if (slot == FailureRetention::NONE)
+				continue;
+			// the slots share the retained bytes; a new noise level adds slots of its own, the kept samples make room
+			auto window = std::max(MIN_SAMPLE_LINE_BYTES, RETAINED_SAMPLE_BYTES / (3 * std::max<size_t>(1, retention_.capacity())));
+			if (window < sample_line_bytes_)
+				for (auto &s : failed_samples_)
+					narrow_sample_(s, window);
+			sample_line_bytes_ = window;
+			auto sample = sample_window_(first + f, sources[f], noised[f], decoded[f], window);
+			if (slot == failed_samples_.size())
+				failed_samples_.push_back(std::move(sample));
+			else
+				failed_samples_[slot] = std::move(sample);
+		}
+		num_streamed_ += sources.size();
+		addBatch_(batch);
+		return first;
+	}
+
+	void NTIChannelTester::setAlgoDecodeResponse(size_t test, const std::string& response) noexcept(false)
+	{
+		if (test >= tests_.size())
+			throw std::runtime_error("[setAlgoDecodeResponse] Unknown test #" + std::to_string(test + 1));
+		auto source = tests_[test].source;
+		if (!decoded_[test])
+		{
+			decoded_[test] = true;
+			++num_decoded_;
+		}
+		else // replaces the previous response
+		{
+			stats_.removeDecoded(tests_[test].noise_level, sources_.length(source), decodeSample_(test));
+			if (failed_[test])
+			{
+				ErrorHeatmap previous(heatmap_.by_offset.size());
+				const auto &r = decode_responses_[test];
+				accumulate_errors(r.data(), r.size(), sources_.data(source), sources_.length(source), previous);
+				heatmap_.subtract(previous);
+			}
+		}
+		decode_responses_[test] = response;
 		// update failed tests if failed or remove from failed if updated
-		if (response == noised_data->source_data)
+		auto cmp = compare_lines(response.data(), response.size(), sources_.data(source), sources_.length(source));
+		if (!cmp.equal())
+			accumulate_errors(response.data(), response.size(), sources_.data(source), sources_.length(source), heatmap_);
+		auto errors = errors_(cmp, response.data(), response.size(), sources_.data(source), sources_.length(source));
+		num_many_errors_ -= measurements_[test].mismatches > THRESHOLD_FAILS;
+		num_many_errors_ += errors > THRESHOLD_FAILS;
+		measurements_[test].mismatches = errors;
+		measurements_[test].residual_bits = cmp.bit_errors;
+		measurements_[test].longest_burst = cmp.longest_burst;
+		bool failed = cmp.mismatches != 0;
+		if (failed != failed_[test])
 		{
-			auto it = failed_tests_.find(noised_data);
-			if (it != failed_tests_.cend()) failed_tests_.erase(it);
+			failed_[test] = failed;
+			failed ? ++num_failed_ : --num_failed_;
 		}
-		else
-			this->failed_tests_.emplace(noised_data);
-		calc_success_rate_ = this->num_success_tests() / static_cast<float>(this->num_finished_tests());
+		stats_.addDecoded(tests_[test].noise_level, sources_.length(source), decodeSample_(test));
+		updateRates_();
+	}
+
+	const std::vector<TestMeasurement>& NTIChannelTester::lastBatch() const
+	{
+		return last_batch_;
 	}
 
 	float NTIChannelTester::success_rate() const
@@ -89,14 +380,44 @@ namespace nti
 		return calc_speed_;
 	}
 
+	void NTIChannelTester::setCodewordLength(size_t length)
+	{
+		heatmap_ = ErrorHeatmap(length);
+	}
+
+	void NTIChannelTester::setEditDistance(size_t max_distance)
+	{
+		// a narrower band could not tell whether a test has more than THRESHOLD_FAILS errors
+		edit_distance_ = max_distance ? std::max(max_distance, THRESHOLD_FAILS) : 0;
+	}
+
+	void NTIChannelTester::setFailureRetention(FailureRetention::Policy policy, size_t limit)
+	{
+		retention_ = FailureRetention(policy, limit);
+		failed_samples_.clear();
+		sample_line_bytes_ = std::numeric_limits<size_t>::max();
+	}
+
+	TestReport::FailReason NTIChannelTester::decidedFailure(size_t total_tests) const
+	{
+		// even if every remaining test succeeds, the success rate stays below the threshold
+		if (total_tests && total_tests >= num_finished_tests() &&
+			static_cast<float>(total_tests - num_failed_tests()) / total_tests < THRESHOLD_SUCCESS_RATE)
+			return TestReport::FailReason::DECODE_FAILURE_RATE_HIGH;
+		// a single test with too many errors fails the whole run
+		if (num_many_errors_)
+			return TestReport::FailReason::DECODE_FAILURE_MANY_ERRORS;
+		return TestReport::FailReason::NONE;
+	}
+
 	size_t NTIChannelTester::num_tests() const
 	{
-		return this->noised_responses_.size();
+		return this->tests_.size() + num_streamed_;
 	}
 
 	size_t NTIChannelTester::num_finished_tests() const
 	{
-		return this->decode_responses_.size();
+		return num_decoded_;
 	}
 
 	size_t NTIChannelTester::num_success_tests() const
@@ -106,46 +427,51 @@ namespace nti
 
 	size_t NTIChannelTester::num_failed_tests() const
 	{
-		return failed_tests_.size();
+		return num_failed_;
 	}
 
 	float NTIChannelTester::find_least_successfull_rate_() const
 	{
-		std::map<float, size_t> noise_to_fails;
-		for (auto fail : failed_tests_)
-			noise_to_fails[fail->noise_level]++;
+		// levels come sorted, so the first maximum is the lowest level with most failures
+		float ret = -1;
+		size_t most = 0;
+		for (const auto &b : stats_.byNoiseLevel())
+			if (b.second.num_failed > most)
+			{
+				most = b.second.num_failed;
+				ret = b.first;
+			}
+		return ret;
+	}
 
-		using pt = decltype(noise_to_fails)::value_type;
-		auto m = std::max_element(noise_to_fails.begin(), noise_to_fails.end(), [](const pt &a, const pt &b) { return a.second < b.second; });
-		return m == noise_to_fails.end() ? -1 : m->first;
+	std::vector<NoiseLevelErrors> NTIChannelTester::error_rates_() const
+	{
+		std::vector<NoiseLevelErrors> ret;
+		for (const auto &level : stats_.byNoiseLevel())
+		{
+			const auto &stats = level.second;
+			if (stats.success.count() == 0)
+				continue;
+			const auto &q = stats.residual_ber_quantiles;
+			ret.push_back(NoiseLevelErrors{ level.first, stats.success.count(), stats.channel_ber.count() ? stats.channel_ber.mean() : -1,
+				stats.residual_ber.mean(), q.quantile(0.5), q.quantile(0.9), q.quantile(0.99), stats.residual_ber.max() });
+		}
+		return ret;
 	}
 
 	std::pair<bool, TestReport::FailReason> NTIChannelTester::verify_passed_() const
 	{
 		auto reason = TestReport::FailReason::NONE;
 		bool has_passed = calc_speed_ >= THRESHOLD_CALC_SPEED && calc_success_rate_ >= THRESHOLD_SUCCESS_RATE;
-		auto has_failed = [](const std::string &source, const std::string &decoded)
-		{
-			size_t n = 0;
-			for (size_t i = 0, ss = source.size(), ds = source.size(); i < ss && i < ds; ++i)
-				if (source[i] != decoded[i])
-					if (++n > THRESHOLD_FAILS)
-						return true;
-			return false;
-		};
-
 		if (has_passed)
-			// check last condition - no errors more than
-			for (auto fail : failed_tests_)
+		{
+			// check last condition - no errors more than (counted once, when the test was checked)
+			if (num_many_errors_)
 			{
-				const auto &dr = decode_responses_.at(fail);
-				if (has_failed(fail->source_data, dr))
-				{
-					has_passed = false;
-					reason = TestReport::FailReason::DECODE_FAILURE_MANY_ERRORS;
-					break;
-				}
+				has_passed = false;
+				reason = TestReport::FailReason::DECODE_FAILURE_MANY_ERRORS;
 			}
+		}
 		else
 		{
 			// check fail reason between speed or anything
@@ -157,24 +483,35 @@ namespace nti
 		return std::make_pair<bool, TestReport::FailReason>(std::move(has_passed), std::move(reason));
 	}
 
-	TestReport NTIChannelTester::generateReport(std::vector<std::string> decoded_for_ordering) const
+	TestReport NTIChannelTester::generateReport() const
 	{
 		TestReport ret;
 		ret.num_success = num_success_tests();
+		ret.num_failed = num_failed_tests();
 		ret.mean_encode_speed = calc_speed_;
 		ret.mean_decode_success_rate = calc_success_rate_;
 		auto r = verify_passed_(); 
 		ret.has_passed = r.first; ret.fail_reason = r.second;
 		ret.least_successful_error_rate = find_least_successfull_rate_();
-		for (auto fail : failed_tests_)
-		{
-			const auto &dr = decode_responses_.at(fail);
-			auto pos = std::find(decoded_for_ordering.begin(), decoded_for_ordering.end(), dr);
-			if (pos == decoded_for_ordering.end())
-				throw std::runtime_error("[generateReport] Couldn't find decoded response!");
-
-			ret.failed_tests.push_back(pos - decoded_for_ordering.begin());
-		}
+		ret.error_rates = error_rates_();
+		ret.statistics = stats_;
+		ret.heatmap = heatmap_;
+		ret.edit_distance = edit_distance_;
+		// registered tests can still change, so their failures are chosen now, by the same policy
+		FailureRetention registered(retention_.policy(), retention_.limit());
+		for (size_t i = 0, s = tests_.size(); i < s; ++i)
+			if (failed_[i])
+			{
+				auto slot = registered.offer(FailureRetention::Candidate{ i, tests_[i].noise_level, measurements_[i].mismatches });
+				if (slot == ret.failed_tests.size())
+					ret.failed_tests.push_back(i);
+				else if (slot != FailureRetention::NONE)
+					ret.failed_tests[slot] = i;
+			}
+		std::sort(ret.failed_tests.begin(), ret.failed_tests.end());
+		ret.failed_samples = failed_samples_;
+		std::sort(ret.failed_samples.begin(), ret.failed_samples.end(), [](const FailedSample &a, const FailedSample &b) { return a.test < b.test; });
+		ret.retention = FailureRetention::PolicyName(retention_.policy());
 
 		return ret;
 	}
@@ -183,11 +520,11 @@ namespace nti
 	std::vector<std::pair<NoisedData, std::string>> NTIChannelTester::failed() const
 	{
 		std::vector<std::pair<NoisedData, std::string>> ret;
-		for (auto fail : failed_tests_)
-		{
-			const auto &dr = decode_responses_.at(fail);
-			ret.push_back(std::pair<NoisedData, std::string>(NoisedData(*fail), dr));
-		}
+		for (size_t i = 0, s = tests_.size(); i < s; ++i)
+			if (failed_[i])
+				ret.push_back(std::pair<NoisedData, std::string>(NoisedData(sources_.str(tests_[i].source), tests_[i].response, tests_[i].noise_level), decode_responses_[i]));
+		for (const auto &f : failed_samples_)
+			ret.push_back(std::pair<NoisedData, std::string>(NoisedData(f.source.input, f.noised.input, f.source.noise_level), f.decoded));
 		return ret;
 	}
 
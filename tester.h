@@ -1,8 +1,13 @@
 #pragma once
 #include "noise.h"
+#include "stats.h"
+#include "intern.h"
+#include "retention.h"
+#include "compare.h"
 #include <string>
 #include <map>
 #include <set>
+#include <limits>
 
 namespace nti
 {
@@ -14,6 +19,52 @@ namespace nti
 		std::string input;
 	};
 
+	// what the checker measured for a single test
+	struct TestMeasurement
+	{
+		size_t mismatches = { 0 };    // differing characters (or edits, when aligned), decoded vs source
+		size_t residual_bits = { 0 }; // differing bits, decoded vs source
+		size_t longest_burst = { 0 }; // longest run of differing characters, decoded vs source
+		size_t channel_bits = { 0 };  // bits flipped by the channel, noised vs encoded
+		bool has_channel = { false }; // noised data was given
+	};
+
+	// how likely the noise of a biased test is under its nominal flip probability: bits drawn, how many of them flipped,
+	// and the log of the likelihood ratio, nominal over biased
+	struct NoiseLikelihood
+	{
+		uint64_t flips = { 0 }, bits = { 0 };
+		double log_ratio = { 0 };
+	};
+
+	// what a fingerprinted corpus tells of the sources of a batch: their hashes and which decoded lines hash the same.
+	// Sources of matched tests are not needed - their inputs may be left empty.
+	struct SourceFingerprints
+	{
+		std::vector<uint64_t> hashes;
+		std::vector<char> matched;
+	};
+
+	// a failed test kept by the streaming checker along with everything the report prints about it;
+	// lines too long for their share of the retained bytes are kept as a window around the first mismatch
+	struct FailedSample
+	{
+		size_t test;
+		UserTestInput source, noised;
+		std::string decoded;
+		size_t offset = {0}; // of the window in every line
+		bool cut = {false};
+	};
+
+	// distribution of bit error rates over the tests of one noise level
+	struct NoiseLevelErrors
+	{
+		float noise_level;
+		size_t num_tests;
+		double channel_ber_mean; // realized channel BER, -1 - N/A
+		double residual_ber_mean, residual_ber_p50, residual_ber_p90, residual_ber_p99, residual_ber_max;
+	};
+
 	struct TestReport
 	{
 		enum class FailReason { ENCODE_SPEED_LOW, DECODE_FAILURE_RATE_HIGH, NONE,DECODE_FAILURE_MANY_ERRORS};
@@ -21,14 +72,24 @@ namespace nti
 		// directly from the tester
 		FailReason fail_reason = { FailReason::NONE };
 		size_t num_success; 
+		size_t num_failed;
 		bool has_passed;
-		std::vector<size_t> failed_tests;
+		std::vector<size_t> failed_tests; // lines of these are given to the serializer
+		std::vector<FailedSample> failed_samples; // streamed failures, carrying their own lines
+		std::string retention; // policy the listed failures were chosen by
+		std::vector<size_t> test_ids; // original (zero-based) number of every checked test, empty if whole corpus was checked
 		// mean values
 		float mean_decode_success_rate;
 		float mean_encode_speed;
 		// integrated over tests
 		float least_successful_error_rate; // -1 - N/A
-
+		std::vector<NoiseLevelErrors> error_rates; // by noise level, ascending
+		TestStatistics statistics;
+		ErrorHeatmap heatmap; // of residual errors
+		// fail fast: checking stopped as soon as the verdict could not change any more
+		bool is_partial = { false };
+		size_t num_total_tests = { 0 }; // tests in the whole corpus, 0 - unknown
+		size_t edit_distance = { 0 }; // failed tests are aligned within this many edits, 0 - compared position by position
 
 		std::string reasonToString() const;
 	};
@@ -41,15 +102,46 @@ namespace nti
 
 		virtual std::vector<UserTestInput> generateInputs(size_t num_tests, float noise_level, size_t max_length) const = 0;
 		virtual std::vector<UserTestInput> generateNoisedInputs(const std::vector<UserTestInput>& inputs, const std::vector<std::string>& encoded) const = 0;
-
-		virtual const NoisedData * setAlgoEncodeResponse(const std::string& source, const std::string& response, float noise_level) = 0;
-		virtual void setAlgoDecodeResponse(const NoisedData *noised_data, const std::string &response) = 0;
+		// reproducible noise: test 'first_test + i' is noised by its own counter-based stream of 'seed', so any encoding
+		// of it sees the same bit flips at the same positions
+		virtual std::vector<UserTestInput> generateNoisedInputs(const std::vector<UserTestInput>& inputs, const std::vector<std::string>& encoded,
+			uint64_t seed, size_t first_test) const = 0;
+		// 'repeat' noised variants of every input, in input order; variant 'v' of input 'i' is noised by stream
+		// '(first_test + i) * repeat + v' of 'seed', so one variant is the same as the seeded 'generateNoisedInputs'
+		virtual std::vector<UserTestInput> generateNoisedRepeats(const std::vector<UserTestInput>& inputs, const std::vector<std::string>& encoded,
+			size_t repeat, uint64_t seed, size_t first_test) const = 0;
+		// noised at flip probability 'bias' instead of the noise level of the input (which the noised input keeps),
+		// like the seeded 'generateNoisedInputs'; 'likelihoods' get the weight of every test for importance sampling
+		virtual std::vector<UserTestInput> generateBiasedInputs(const std::vector<UserTestInput>& inputs, const std::vector<std::string>& encoded,
+			float bias, uint64_t seed, size_t first_test, std::vector<NoiseLikelihood> &likelihoods) const = 0;
+
+		// registers a new test, returns its number
+		virtual size_t setAlgoEncodeResponse(const std::string& source, const std::string& response, float noise_level) = 0;
+		virtual void setAlgoDecodeResponse(size_t test, const std::string &response) = 0;
+		// registers and checks a whole batch of tests at once, returns number of the first one
+		virtual size_t setAlgoResponses(const std::vector<UserTestInput> &sources, const std::vector<UserTestInput> &noised,
+			const std::vector<std::string> &encoded, const std::vector<std::string> &decoded) noexcept(false) = 0;
+		// checks a batch like setAlgoResponses, but keeps nothing of it except statistics and a bounded sample of failures
+		virtual size_t streamAlgoResponses(const std::vector<UserTestInput> &sources, const std::vector<UserTestInput> &noised,
+			const std::vector<std::string> &encoded, const std::vector<std::string> &decoded,
+			const SourceFingerprints *fingerprints = nullptr) noexcept(false) = 0;
 
 		virtual float success_rate() const = 0;
 		virtual float speed() const = 0;
+		// codeword length residual error offsets are folded by, 0 - not collected; to be set before any test is checked
+		virtual void setCodewordLength(size_t length) = 0;
+		// score decoded lines by edit distance within this band (at least THRESHOLD_FAILS) instead of position by position,
+		// 0 - positional; to be set before any test is checked
+		virtual void setEditDistance(size_t max_distance) = 0;
+		// which failed tests are kept for the report; to be set before any test is checked
+		virtual void setFailureRetention(FailureRetention::Policy policy, size_t limit) = 0;
+		// failure which no result of the remaining tests can undo, NONE while the verdict is open (total_tests - 0 if unknown)
+		virtual TestReport::FailReason decidedFailure(size_t total_tests) const = 0;
 		virtual std::vector<std::pair<NoisedData, std::string>> failed() const = 0;
+		// measurements of the tests of the last setAlgoResponses/streamAlgoResponses batch, in batch order
+		virtual const std::vector<TestMeasurement> &lastBatch() const = 0;
 
-		virtual TestReport generateReport(std::vector<std::string> decoded_for_ordering) const = 0;
+		virtual TestReport generateReport() const = 0;
 
 		virtual ~IChannelTester() = default;
 	};
@@ -58,38 +150,98 @@ namespace nti
 
 	class NTIChannelTester : public IChannelTester
 	{
-		std::map<const NoisedData*, std::string> decode_responses_;
-		std::map<std::string, std::unique_ptr<NoisedData>> noised_responses_;
-
-		std::set<const NoisedData*> failed_tests_;
+		// a registered test; its source lives in the arena, shared with every duplicate of it
+		struct Test_
+		{
+			size_t source;
+			std::string response; // of the encoder
+			float noise_level;
+		};
+
+		// everything is indexed by test number
+		InternArena sources_;
+		std::vector<Test_> tests_;
+		std::vector<std::string> decode_responses_;
+		std::vector<bool> decoded_, failed_;
+		std::vector<TestMeasurement> measurements_, last_batch_;
+		size_t num_decoded_ = { 0 }, num_failed_ = { 0 };
+		size_t num_many_errors_ = { 0 }; // tests failed with more than THRESHOLD_FAILS mismatches
+		size_t num_streamed_ = { 0 }; // checked, but not kept
+		FailureRetention retention_;
+		std::vector<FailedSample> failed_samples_; // by retention slot
+		size_t sample_line_bytes_ = { std::numeric_limits<size_t>::max() }; // bytes of a line every kept sample is cut to
+		TestStatistics stats_;
+		ErrorHeatmap heatmap_;
+		size_t edit_distance_ = { 0 };
 
 		float calc_speed_ = { 0 };
 		float calc_success_rate_ = { 0 };
 
+		TestStatistics::DecodeSample decodeSample_(size_t test) const;
+		// errors of decoded vs source: the edit distance when aligned, the positional count if beyond the band
+		size_t errors_(const CompareResult &cmp, const char *decoded, size_t decoded_size, const char *source, size_t source_size) const;
+		void updateRates_();
+
+		// measurements of a checked batch, numbers of failed tests are relative to the batch
+		struct Batch_
+		{
+			std::vector<TestMeasurement> measurements;
+			std::vector<uint64_t> hashes; // of the sources
+			std::vector<size_t> failed;
+			size_t many_errors = { 0 };
+			TestStatistics stats;
+			ErrorHeatmap heatmap;
+
+			explicit Batch_(size_t codeword_length) : heatmap(codeword_length) {}
+		};
+		Batch_ measureBatch_(const std::vector<UserTestInput> &sources, const std::vector<UserTestInput> &noised,
+			const std::vector<std::string> &encoded, const std::vector<std::string> &decoded,
+			const SourceFingerprints *fingerprints = nullptr) const noexcept(false);
+		void addBatch_(const Batch_ &batch);
+
 		std::pair<bool, TestReport::FailReason>  verify_passed_() const;
 	public:
 		static const size_t THRESHOLD_FAILS;
+		// lines of all retained failures together, a line never gets less than the minimum
+		static const size_t RETAINED_SAMPLE_BYTES, MIN_SAMPLE_LINE_BYTES;
 		static const float THRESHOLD_CALC_SPEED, THRESHOLD_SUCCESS_RATE;
 
 
 		std::vector<UserTestInput> generateInputs(size_t num_inputs, float noise_level, size_t max_length) const override;
 		std::vector<UserTestInput> generateNoisedInputs(const std::vector<UserTestInput>& inputs, const std::vector<std::string>& encoded) const override;
-
-		const NoisedData * setAlgoEncodeResponse(const std::string& source, const std::string& response, float noise_level) override;
-		void setAlgoDecodeResponse(const NoisedData *noised_data, const std::string &response) override;
+		std::vector<UserTestInput> generateNoisedInputs(const std::vector<UserTestInput>& inputs, const std::vector<std::string>& encoded,
+			uint64_t seed, size_t first_test) const override;
+		std::vector<UserTestInput> generateNoisedRepeats(const std::vector<UserTestInput>& inputs, const std::vector<std::string>& encoded,
+			size_t repeat, uint64_t seed, size_t first_test) const override;
+		std::vector<UserTestInput> generateBiasedInputs(const std::vector<UserTestInput>& inputs, const std::vector<std::string>& encoded,
+			float bias, uint64_t seed, size_t first_test, std::vector<NoiseLikelihood> &likelihoods) const override;
+
+		size_t setAlgoEncodeResponse(const std::string& source, const std::string& response, float noise_level) override;
+		void setAlgoDecodeResponse(size_t test, const std::string &response) noexcept(false) override;
+		size_t setAlgoResponses(const std::vector<UserTestInput> &sources, const std::vector<UserTestInput> &noised,
+			const std::vector<std::string> &encoded, const std::vector<std::string> &decoded) noexcept(false) override;
+		size_t streamAlgoResponses(const std::vector<UserTestInput> &sources, const std::vector<UserTestInput> &noised,
+			const std::vector<std::string> &encoded, const std::vector<std::string> &decoded,
+			const SourceFingerprints *fingerprints = nullptr) noexcept(false) override;
 
 
 		float success_rate() const override;
 		float speed() const override;
+		void setCodewordLength(size_t length) override;
+		void setEditDistance(size_t max_distance) override;
+		void setFailureRetention(FailureRetention::Policy policy, size_t limit) override;
+		TestReport::FailReason decidedFailure(size_t total_tests) const override;
 
 		size_t num_tests() const;
 		size_t num_finished_tests() const;
 		size_t num_success_tests() const;
 		size_t num_failed_tests() const;
 		float find_least_successfull_rate_() const;
+		std::vector<NoiseLevelErrors> error_rates_() const;
 
-		TestReport generateReport(std::vector<std::string> decoded_for_ordering) const;
+		TestReport generateReport() const override;
 		std::vector<std::pair<NoisedData, std::string>> failed() const override;
+		const std::vector<TestMeasurement> &lastBatch() const override;
 
 		~NTIChannelTester() override = default;
 	};
@@ -3,6 +3,14 @@
 
 #include "catch.hpp"
 #include "../utils.h"
+#include "../data.h"
+#include "../compare.h"
+#include "../stats.h"
+#include "../hash.h"
+#include "../intern.h"
+#include "../retention.h"
+#include <sstream>
+#include <fstream>
 TEST_CASE("Split works on chars", "[utils]")
 {
 	static const std::string test_string = "1,2,3,4,5";
@@ -27,4 +35,607 @@ TEST_CASE("Split works on many delimeters in a row", "[utils]")
 	REQUIRE(vec == test_ok);
 }
 
+TEST_CASE("Split ranges match split tokens", "[utils]")
+{
+	static const std::string test_string = "ab\r\n\r\ncd\r\ne\r\n";
+	static const std::vector<std::pair<size_t, size_t>> test_ok = { { 0, 2 }, { 6, 8 }, { 10, 11 } };
+	auto ranges = split_ranges(test_string.data(), test_string.size(), "\r\n");
+	REQUIRE(ranges == test_ok);
+	REQUIRE(split(test_string, "\r\n") == std::vector<std::string>({ "ab", "cd", "e" }));
+}
+
+TEST_CASE("Parallel for covers every item once", "[utils]")
+{
+	std::vector<int> hits(1000, 0);
+	parallel_for(hits.size(), [&hits](size_t, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			++hits[i];
+	});
+	REQUIRE(std::all_of(hits.begin(), hits.end(), [](int h) { return h == 1; }));
+
+	// the same workers take job after job, a nested job runs on threads of its own
+	for (int r = 0; r < 100; ++r)
+		parallel_for(hits.size(), [&hits](size_t, size_t begin, size_t end)
+		{
+			parallel_for(end - begin, [&hits, begin](size_t, size_t b, size_t e)
+			{
+				for (size_t i = begin + b; i < begin + e; ++i)
+					++hits[i];
+			});
+		});
+	REQUIRE(std::all_of(hits.begin(), hits.end(), [](int h) { return h == 101; }));
+	REQUIRE_THROWS_AS(parallel_for(hits.size(), [](size_t, size_t begin, size_t) { if (begin == 0) throw std::runtime_error("shard"); }), std::runtime_error);
+}
+
+TEST_CASE("Line reader yields split tokens", "[data]")
+{
+	static const std::string test_string = "\r\nab\r\n\r\nc\rd\r\ne\r";
+	nti::LineReader reader(std::make_shared<std::istringstream>(test_string));
+	std::vector<std::string> lines;
+	std::string line;
+	while (reader.next(line))
+		lines.push_back(line);
+	REQUIRE(lines == split(test_string, "\r\n"));
+}
+
+TEST_CASE("Serialized data has exact size and parses back", "[data]")
+{
+	static const std::vector<nti::UserTestInput> test_data = {
+		{ "encode", 0.1f, "abc" }, { "encode", 1e-5f, "x" }, { "decode", 0.123456789f, "long line" }, { "encode", 0, "z" } };
+	nti::NTIChannelTesterSerializer serializer;
+	nti::NTIChannelTesterParser parser;
+	auto serialized = serializer.serializeData(test_data);
+	REQUIRE(serialized.size() == serializer.serializedSize(test_data));
+	REQUIRE(serialized.substr(0, 19) == "encode 0.1 abc\r\nenc");
+	auto parsed = parser.parseInput(serialized);
+	REQUIRE(parsed.size() == test_data.size());
+	for (size_t i = 0; i < parsed.size(); ++i)
+	{
+		REQUIRE(parsed[i].mode == test_data[i].mode);
+		REQUIRE(parsed[i].noise_level == test_data[i].noise_level);
+		REQUIRE(parsed[i].input == test_data[i].input);
+	}
+}
+
+TEST_CASE("Index records the data file it was written for", "[data]")
+{
+	static const std::vector<nti::UserTestInput> test_data = { { "encode", 0.1f, "abc" }, { "encode", 0.2f, "de" } };
+	nti::NTIChannelTesterSerializer serializer;
+	nti::NTIChannelTesterParser parser;
+	auto data = serializer.serializeData(test_data);
+	auto index = serializer.indexData(test_data);
+	// nothing recorded: the last line must end where the data does, give or take its delimiter
+	REQUIRE(index.describes(data.size(), 123));
+	REQUIRE_FALSE(index.describes(data.size() + 10, 123));
+	REQUIRE_FALSE(index.describes(data.size() - 4, 123));
+	index.data_size = data.size();
+	index.data_mtime = 123;
+	auto parsed = parser.parseIndex(serializer.serializeIndex(index));
+	REQUIRE(parsed.data_size == data.size());
+	REQUIRE(parsed.describes(data.size(), 123));
+	REQUIRE_FALSE(parsed.describes(data.size(), 124)); // rewritten with the same size
+	REQUIRE(parsed.offsets == index.offsets);
+}
+
+TEST_CASE("Source index keeps line fingerprints", "[data]")
+{
+	static const std::vector<nti::UserTestInput> test_data = { { "encode", 0.1f, "abc" }, { "encode", 0.2f, "" } };
+	nti::NTIChannelTesterSerializer serializer;
+	nti::NTIChannelTesterParser parser;
+	auto index = serializer.indexData(test_data);
+	REQUIRE(index.hasFingerprints());
+	REQUIRE(index.fingerprints[0] == nti::hash64("abc"));
+	auto parsed = parser.parseIndex(serializer.serializeIndex(index));
+	REQUIRE(parsed.fingerprints == index.fingerprints);
+	REQUIRE(parsed.noise_levels == index.noise_levels);
+
+	// a matching fingerprint stands in for the source, a mismatching one needs the real line
+	std::vector<nti::UserTestInput> sources = { { "encode", 0.1f, "" }, { "encode", 0.2f, "" } }, noised = test_data;
+	std::vector<std::string> encoded = { "abcabc", "" }, decoded = { "abc", "X" };
+	nti::SourceFingerprints fingerprints;
+	fingerprints.hashes = index.fingerprints;
+	fingerprints.matched = { 1, 0 };
+	sources[1] = test_data[1];
+	nti::NTIChannelTester tester;
+	REQUIRE(tester.streamAlgoResponses(sources, noised, encoded, decoded, &fingerprints) == 0);
+	REQUIRE(tester.generateReport().failed_samples[0].test == 1);
+}
+
+TEST_CASE("Report shows failed tests in order, windowed or not at all", "[data]")
+{
+	std::vector<nti::UserTestInput> sources, noised;
+	std::vector<std::string> encoded, decoded;
+	for (int i = 0; i < 50; ++i)
+	{
+		sources.push_back({ "encode", 0.1f, "0123456789abcdefghij" + std::to_string(i) });
+		noised.push_back(sources.back());
+		encoded.push_back(sources.back().input);
+		decoded.push_back(sources.back().input);
+		decoded.back()[10] = '#';
+	}
+	nti::NTIChannelTester tester;
+	tester.setAlgoResponses(sources, noised, encoded, decoded);
+	nti::NTIChannelTesterSerializer serializer;
+	auto report = tester.generateReport();
+	auto whole = serializer.serializeReport(report, sources, noised, decoded);
+	REQUIRE(whole.find("GENERATED: 0123456789   a   bcdefghij0\n") != std::string::npos);
+	REQUIRE(whole.find("TEST #49.") < whole.find("TEST #50."));
+
+	nti::ReportLayout layout;
+	layout.context = 2;
+	auto windowed = serializer.serializeReport(report, sources, noised, decoded, layout);
+	REQUIRE(windowed.find("DECODED:   [...]89   #   bc[...]\n") != std::string::npos);
+	std::string line = "0123456789abcdefghijklmnopqrstuvwxyz", two = line;
+	two[5] = two[25] = '#';
+	nti::NTIChannelTester spans;
+	spans.setAlgoResponses({ { "encode", 0.1f, line } }, { { "decode", 0.1f, line } }, { line }, { two });
+	auto both = serializer.serializeReport(spans.generateReport(), { { "encode", 0.1f, line } }, { { "decode", 0.1f, line } }, { two }, layout);
+	REQUIRE(both.find("DECODED:   [...]34   #   67[...]no   #   qr[...]\n") != std::string::npos);
+	layout.summary = true;
+	REQUIRE(serializer.serializeReport(report, sources, noised, decoded, layout).find("TEST #") == std::string::npos);
+}
+
+TEST_CASE("Buffered sink writes everything in order", "[data]")
+{
+	auto os = std::make_shared<std::ostringstream>();
+	std::string expected;
+	{
+		nti::NTIBufferedSink sink(os, "test", 7);
+		for (int i = 0; i < 100; ++i)
+		{
+			auto chunk = std::to_string(i) + std::string(i % 13, 'x');
+			sink.append(chunk);
+			expected += chunk;
+		}
+		REQUIRE(sink.size() == expected.size());
+		sink.close();
+	}
+	REQUIRE(os->str() == expected);
+}
+
+TEST_CASE("Buffered sink reports a write error instead of aborting", "[data]")
+{
+	auto full = std::make_shared<std::ofstream>("/dev/full", std::ios::binary);
+	if (!*full)
+		return; // no such device here
+	const std::string chunk(1 << 20, 'x');
+	auto write_all = [&]()
+	{
+		nti::NTIBufferedSink sink(full, "/dev/full");
+		for (int i = 0; i < 9; ++i)
+			sink.append(chunk);
+		sink.close();
+	};
+	REQUIRE_THROWS_AS(write_all(), std::runtime_error);
+}
+
+TEST_CASE("Tester reports failures in test order", "[tester]")
+{
+	nti::NTIChannelTester tester;
+	std::vector<std::string> sources = { "abc", "abc", "xyz", "qqq" }, decoded = { "abc", "abd", "xyz", "qqx" };
+	for (size_t i = 0; i < sources.size(); ++i)
+		tester.setAlgoDecodeResponse(tester.setAlgoEncodeResponse(sources[i], sources[i] + sources[i], 0.1f), decoded[i]);
+	auto report = tester.generateReport();
+	REQUIRE(tester.num_tests() == 4);
+	REQUIRE(report.num_success == 2);
+	REQUIRE(report.failed_tests == std::vector<size_t>({ 1, 3 }));
+	REQUIRE(report.least_successful_error_rate == 0.1f);
+}
+
+TEST_CASE("Line comparison finds first mismatch and counts all", "[compare]")
+{
+	std::string a(100, 'a'), b = a;
+	REQUIRE(nti::compare_lines(a, b).equal());
+	b[37] = 'x'; b[38] = 'y'; b[99] = 'z';
+	auto cmp = nti::compare_lines(a, b);
+	REQUIRE(cmp.first_mismatch == 37);
+	REQUIRE(cmp.mismatches == 3);
+	// 'a'^'x' = 0x19, 'a'^'y' = 0x18, 'a'^'z' = 0x1b
+	REQUIRE(cmp.bit_errors == 3 + 2 + 4);
+	REQUIRE(cmp.longest_burst == 2);
+	cmp = nti::compare_lines(a, a.substr(0, 90));
+	REQUIRE(cmp.first_mismatch == 90);
+	REQUIRE(cmp.mismatches == 10);
+	REQUIRE(cmp.bit_errors == 80);
+	REQUIRE(cmp.longest_burst == 10);
+}
+
+TEST_CASE("Mismatch spans are merged across steps and glue", "[compare]")
+{
+	std::string a(300, 'a'), b = a;
+	for (auto p : { 0, 2, 63, 64, 65, 130, 200 })
+		b[p] = 'b';
+	b += "tail";
+	std::vector<std::pair<size_t, size_t>> spans;
+	nti::mismatch_spans(a, b, 3, spans);
+	REQUIRE(spans == (std::vector<std::pair<size_t, size_t>>{ { 0, 3 }, { 63, 66 }, { 130, 131 }, { 200, 201 }, { 300, 304 } }));
+	nti::mismatch_spans(a, b, 0, spans);
+	REQUIRE(spans.size() == 6);
+	nti::mismatch_spans(a, a, 3, spans);
+	REQUIRE(spans.empty());
+}
+
+TEST_CASE("Banded edit distance aligns shifted lines", "[compare]")
+{
+	// a dropped character is one edit, not a mismatch in every following position
+	std::string source = "abcdefghij", decoded = "bcdefghij";
+	REQUIRE(nti::compare_lines(decoded, source).mismatches == 10);
+	auto aligned = nti::edit_distance(source, decoded, 3, true);
+	REQUIRE(aligned.within_band);
+	REQUIRE(aligned.distance == 1);
+	REQUIRE(aligned.spans.size() == 1);
+	REQUIRE(aligned.spans[0].a_begin == 0);
+	REQUIRE(aligned.spans[0].a_end == 1);
+	REQUIRE(aligned.spans[0].b_begin == aligned.spans[0].b_end);
+
+	REQUIRE(nti::edit_distance("kitten", "sitting", 3).distance == 3);
+	auto beyond = nti::edit_distance("kitten", "sitting", 2);
+	REQUIRE_FALSE(beyond.within_band);
+	REQUIRE(beyond.distance == 3);
+	// lines longer than a block, differing across its border
+	std::string a;
+	for (int i = 0; i < 200; ++i)
+		a += char('a' + i % 7);
+	std::string b = a;
+	b.insert(b.begin() + 63, 'y');
+	b.erase(b.begin() + 150);
+	REQUIRE(nti::edit_distance(a, b, 10).distance == 2);
+	REQUIRE(nti::edit_distance(a, a, 0).distance == 0);
+
+	nti::NTIChannelTester tester;
+	tester.setEditDistance(8);
+	tester.setAlgoDecodeResponse(tester.setAlgoEncodeResponse(source, source + source, 0.1f), decoded);
+	REQUIRE(tester.decidedFailure(0) == nti::TestReport::FailReason::NONE);
+
+	// the report aligns a failure within its own error count, however wide a band is allowed
+	nti::NTIChannelTester wide;
+	wide.setEditDistance(1000000);
+	std::vector<nti::UserTestInput> lines = { { "encode", 0.1f, a } };
+	wide.setAlgoResponses(lines, lines, { a }, { b });
+	auto report = nti::NTIChannelTesterSerializer().serializeReport(wide.generateReport(), lines, lines, { b });
+	REQUIRE(report.find("   y   ") != std::string::npos);
+
+	// a character dropped at the start of a long line shifts every position after it, yet is one edit: the spans are
+	// traced within that distance (a traceback over the whole band would take hundreds of megabytes here)
+	wide.setEditDistance(5000);
+	std::string long_line;
+	for (int i = 0; i < 100000; ++i)
+		long_line += char('a' + i % 23);
+	std::vector<nti::UserTestInput> long_lines = { { "encode", 0.1f, long_line } };
+	std::string shifted = long_line.substr(1);
+	wide.setAlgoResponses(long_lines, long_lines, { long_line }, { shifted });
+	auto shifted_report = nti::NTIChannelTesterSerializer().serializeReport(wide.generateReport(), { lines[0], long_lines[0] },
+		{ lines[0], long_lines[0] }, { b, shifted });
+	REQUIRE(shifted_report.find("GENERATED:    a   bcdefg") != std::string::npos);
+}
+
+TEST_CASE("Error heatmap places bits, offsets and bursts", "[compare]")
+{
+	std::string a(40, 'a'), b = a + "zz";
+	b[3] ^= 0x01; b[4] ^= 0x03; b[20] ^= 0x80;
+	nti::ErrorHeatmap heatmap(4);
+	nti::accumulate_errors(b, a, heatmap);
+	REQUIRE(heatmap.by_bit[0] == 2 + 2);
+	REQUIRE(heatmap.by_bit[1] == 1 + 2);
+	REQUIRE(heatmap.by_bit[7] == 1 + 2);
+	// offsets 3, 0 and 0; the extra characters are 40 and 41
+	REQUIRE(heatmap.by_offset == std::vector<uint64_t>({ 2 + 1 + 8, 8, 0, 1 }));
+	REQUIRE(heatmap.by_burst[1] == 1);
+	REQUIRE(heatmap.by_burst[2] == 2);
+	uint64_t bits = 0;
+	for (auto c : heatmap.by_bit)
+		bits += c;
+	REQUIRE(bits == nti::compare_lines(b, a).bit_errors);
+}
+
+TEST_CASE("Batch check matches test by test check", "[tester]")
+{
+	std::vector<nti::UserTestInput> sources = { { "encode", 0.1f, "abc" }, { "encode", 0.2f, "abcdef" }, { "encode", 0.2f, "x" } };
+	std::vector<std::string> encoded = { "abcabc", "abcdefabcdef", "xx" }, decoded = { "abc", "abXXXf", "y" };
+	nti::NTIChannelTester batch, single;
+	batch.setAlgoResponses(sources, sources, encoded, decoded);
+	for (size_t i = 0; i < sources.size(); ++i)
+		single.setAlgoDecodeResponse(single.setAlgoEncodeResponse(sources[i].input, encoded[i], sources[i].noise_level), decoded[i]);
+	auto rb = batch.generateReport(), rs = single.generateReport();
+	REQUIRE(rb.failed_tests == rs.failed_tests);
+	REQUIRE(rb.fail_reason == rs.fail_reason);
+	REQUIRE(rb.mean_encode_speed == Approx(rs.mean_encode_speed));
+	REQUIRE(rb.least_successful_error_rate == 0.2f);
+
+	// streamed tests are counted the same, their failures come with their own lines
+	nti::NTIChannelTester streamed;
+	REQUIRE(streamed.streamAlgoResponses(sources, sources, encoded, decoded) == 0);
+	REQUIRE(streamed.streamAlgoResponses(sources, sources, encoded, decoded) == 3);
+	auto rt = streamed.generateReport();
+	REQUIRE(rt.num_failed == 2 * rb.num_failed);
+	REQUIRE(rt.failed_tests.empty());
+	REQUIRE(rt.failed_samples.size() == 4);
+	REQUIRE(rt.failed_samples[2].test == 4);
+	REQUIRE(rt.failed_samples[2].decoded == "abXXXf");
+	REQUIRE(!rt.failed_samples[2].cut);
+
+	// a line longer than its share of the retained bytes is kept around its first mismatch
+	const size_t window = nti::NTIChannelTester::MIN_SAMPLE_LINE_BYTES;
+	std::string long_line(3 * window, 'a'), long_decoded = long_line;
+	long_decoded[2 * window] = 'b';
+	nti::NTIChannelTester cut;
+	cut.setFailureRetention(nti::FailureRetention::Policy::FIRST, nti::NTIChannelTester::RETAINED_SAMPLE_BYTES / window);
+	std::vector<nti::UserTestInput> long_sources = { { "encode", 0.1f, long_line } };
+	cut.streamAlgoResponses(long_sources, long_sources, { long_line }, { long_decoded });
+	auto sample = cut.generateReport().failed_samples.front();
+	REQUIRE(sample.cut);
+	REQUIRE(sample.offset == 2 * window - window / 4);
+	REQUIRE(sample.decoded.size() == window);
+	REQUIRE(sample.decoded[window / 4] == 'b');
+
+	// every noise level adds slots of its own per_level, the samples kept so far are narrowed to make room
+	nti::NTIChannelTester per_level;
+	per_level.setFailureRetention(nti::FailureRetention::Policy::PER_LEVEL, nti::NTIChannelTester::RETAINED_SAMPLE_BYTES / (6 * window));
+	per_level.streamAlgoResponses(long_sources, long_sources, { long_line }, { long_decoded });
+	REQUIRE(per_level.generateReport().failed_samples.front().offset == 2 * window - window / 2); // a quarter of twice the window
+	std::vector<nti::UserTestInput> other_level = { { "encode", 0.2f, long_line } };
+	per_level.streamAlgoResponses(other_level, other_level, { long_line }, { long_decoded });
+	auto narrowed = per_level.generateReport().failed_samples.front();
+	REQUIRE(narrowed.decoded.size() == window);
+	REQUIRE(narrowed.offset == 2 * window - window / 4);
+	REQUIRE(narrowed.decoded[window / 4] == 'b');
+}
+
+TEST_CASE("Fail fast verdict is decided only when it cannot change", "[tester]")
+{
+	nti::NTIChannelTester tester;
+	for (int i = 0; i < 2; ++i)
+		tester.setAlgoDecodeResponse(tester.setAlgoEncodeResponse("abcd", "abcdabcd", 0.1f), "abcX");
+	REQUIRE(tester.decidedFailure(10) == nti::TestReport::FailReason::NONE);
+	REQUIRE(tester.decidedFailure(0) == nti::TestReport::FailReason::NONE);
+	tester.setAlgoDecodeResponse(tester.setAlgoEncodeResponse("abcd", "abcdabcd", 0.1f), "abcX");
+	REQUIRE(tester.decidedFailure(10) == nti::TestReport::FailReason::DECODE_FAILURE_RATE_HIGH);
+	// too many errors in a single test decide it even without the total
+	tester.setAlgoDecodeResponse(tester.setAlgoEncodeResponse("abcd", "abcdabcd", 0.1f), "XXXX");
+	REQUIRE(tester.decidedFailure(0) == nti::TestReport::FailReason::DECODE_FAILURE_MANY_ERRORS);
+	tester.setAlgoDecodeResponse(3, "abcd");
+	REQUIRE(tester.decidedFailure(0) == nti::TestReport::FailReason::NONE);
+}
+
+TEST_CASE("Duplicate sources share interned bytes but stay distinct tests", "[intern]")
+{
+	REQUIRE(nti::hash64("") == 0xEF46DB3751D8E999ULL);
+	REQUIRE(nti::hash64("abc") == 0x44BC2CF5AD770999ULL);
+	std::string long_line(100, 'q');
+	REQUIRE(nti::hash64(long_line) != nti::hash64(long_line.substr(1)));
+
+	nti::InternArena arena;
+	auto a = arena.intern("abc"), b = arena.intern("abd"), c = arena.intern(std::string("abc"));
+	REQUIRE(a == c);
+	REQUIRE(a != b);
+	REQUIRE(arena.size() == 2);
+	REQUIRE(arena.str(b) == "abd");
+
+	nti::NTIChannelTester tester;
+	tester.setAlgoDecodeResponse(tester.setAlgoEncodeResponse("same", "samesame", 0.1f), "same");
+	tester.setAlgoDecodeResponse(tester.setAlgoEncodeResponse("same", "samesame", 0.1f), "sXme");
+	REQUIRE(tester.num_tests() == 2);
+	REQUIRE(tester.num_failed_tests() == 1);
+	REQUIRE(tester.failed().front().first.source_data == "same");
+}
+
+TEST_CASE("Failure retention stays bounded and keeps what its policy asks for", "[retention]")
+{
+	using nti::FailureRetention;
+	FailureRetention first(FailureRetention::Policy::FIRST, 3), reservoir(FailureRetention::Policy::RESERVOIR, 3),
+		worst(FailureRetention::Policy::WORST, 3), per_level(FailureRetention::Policy::PER_LEVEL, 2);
+	for (size_t i = 0; i < 100; ++i)
+	{
+		FailureRetention::Candidate c{ i, i % 2 ? 0.1f : 0.2f, (i * 37) % 101 };
+		for (auto r : { &first, &reservoir, &worst, &per_level })
+		{
+			auto slot = r->offer(c);
+			REQUIRE((slot == FailureRetention::NONE || slot < r->kept().size()));
+		}
+	}
+	REQUIRE(first.kept().back().test == 2);
+	REQUIRE(reservoir.kept().size() == 3);
+	std::vector<size_t> errors;
+	for (const auto &c : worst.kept())
+		errors.push_back(c.errors);
+	std::sort(errors.begin(), errors.end());
+	REQUIRE(errors == std::vector<size_t>({ 98, 99, 100 }));
+	REQUIRE(per_level.kept().size() == 4);
+	REQUIRE(FailureRetention::ParsePolicy("per_level") == FailureRetention::Policy::PER_LEVEL);
+	REQUIRE_THROWS(FailureRetention::ParsePolicy("last"));
+}
+
+TEST_CASE("Seeded noise flips the same bits of any encoding and pairs verdicts", "[stats]")
+{
+	nti::NTIChannelTester tester;
+	std::vector<nti::UserTestInput> inputs = { { "encode", 0.1f, "src" }, { "encode", 0.1f, "src" } };
+	std::vector<std::string> a = { std::string(200, 'a'), std::string(200, 'a') }, b = { std::string(200, 'b'), std::string(200, 'b') };
+	auto na = tester.generateNoisedInputs(inputs, a, 7, 0), nb = tester.generateNoisedInputs(inputs, b, 7, 0);
+	REQUIRE(na[0].input == tester.generateNoisedInputs(inputs, a, 7, 0)[0].input);
+	REQUIRE(na[0].input != na[1].input); // every test has its own stream
+	REQUIRE(na[1].input == tester.generateNoisedInputs({ inputs[1] }, { a[1] }, 7, 1)[0].input);
+	size_t same = 0;
+	for (size_t k = 0; k < 200; ++k)
+		same += (na[0].input[k] ^ 'a') == (nb[0].input[k] ^ 'b');
+	REQUIRE(same > 190); // except where a flip into a line break or space of one of them had to be drawn again
+
+	nti::PairedStatistics paired;
+	for (int i = 0; i < 10; ++i)
+		paired.add(0.1f, true, i >= 8, 0, i >= 8 ? 0 : 0.5);
+	const auto &p = paired.overall();
+	REQUIRE(p.only_a == 8);
+	REQUIRE(p.both_passed == 2);
+	REQUIRE(p.mcnemarPValue() == Approx(2 * std::pow(0.5, 8)));
+	REQUIRE(p.mcnemarStatistic() == Approx(49.0 / 8));
+	REQUIRE(p.ber_difference.mean() == Approx(-0.4));
+}
+
+TEST_CASE("Repeated noise variants have their own streams and failures are counted per line", "[stats]")
+{
+	nti::NTIChannelTester tester;
+	std::vector<nti::UserTestInput> inputs = { { "encode", 0.1f, "src" }, { "encode", 0.1f, "src" } };
+	std::vector<std::string> encoded = { std::string(100, 'a'), std::string(50, 'b') };
+	auto variants = tester.generateNoisedRepeats(inputs, encoded, 3, 7, 4);
+	REQUIRE(variants.size() == 6);
+	for (size_t i = 0; i < 6; ++i)
+		REQUIRE(variants[i].input == tester.generateNoisedInputs({ inputs[i / 3] }, { encoded[i / 3] }, 7, (4 + i / 3) * 3 + i % 3)[0].input);
+	REQUIRE(variants[0].input != variants[1].input);
+	REQUIRE(tester.generateNoisedRepeats(inputs, encoded, 1, 7, 0)[1].input == tester.generateNoisedInputs(inputs, encoded, 7, 0)[1].input);
+
+	nti::RepeatStatistics repeats(4, 2);
+	for (size_t line = 0; line < 4; ++line)
+		for (size_t v = 0; v < 4; ++v)
+			repeats.add(line, line < 2 ? 0.f : 0.1f, v >= line);
+	auto overall = repeats.overall();
+	REQUIRE(overall.lines == 4);
+	REQUIRE(overall.mean_failure == Approx(6.0 / 16));
+	REQUIRE(overall.never_failed == 1);
+	REQUIRE(overall.always_failed == 0);
+	REQUIRE(overall.low < overall.mean_failure);
+	auto levels = repeats.byNoiseLevel();
+	REQUIRE(levels.size() == 2);
+	REQUIRE(levels[1].mean_failure == Approx(5.0 / 8));
+	auto worst = repeats.worst(2);
+	REQUIRE(worst.size() == 2);
+	REQUIRE(worst[0].line == 3);
+	REQUIRE(worst[0].failures == 3);
+	REQUIRE(worst[1].line == 2);
+	REQUIRE(repeats.worst(10).size() == 2); // no more lines are kept than asked for
+	repeats.add(4, 0.f, true);
+	REQUIRE_THROWS(repeats.add(5, 0.f, true)); // before the other variants of line 4
+}
+
+TEST_CASE("Threshold sweep narrows the bracket to where the success rate turns", "[stats]")
+{
+	// success falls linearly with noise and crosses 0.8 at 0.21
+	auto run = [](nti::ThresholdSweep &sweep)
+	{
+		for (auto levels = sweep.next(); !levels.empty(); levels = sweep.next())
+		{
+			std::vector<size_t> tests(levels.size(), 1000), successes;
+			for (auto l : levels)
+				successes.push_back(size_t(std::max(0.0, 1000 * (1.01 - l))));
+			sweep.record(levels, tests, successes);
+		}
+	};
+	nti::ThresholdSweep sweep(0, 0.4f, 0.001f, 3, 0.8);
+	REQUIRE(sweep.next().size() == 5); // both ends on the first round
+	run(sweep);
+	REQUIRE(sweep.outcome() == nti::ThresholdSweep::Outcome::FOUND);
+	REQUIRE(sweep.low() < 0.21f);
+	REQUIRE(sweep.high() > 0.21f);
+	REQUIRE(sweep.high() - sweep.low() <= 0.001f);
+	REQUIRE(sweep.rounds().size() == 5); // 0.4 / 4^5 < 0.001
+	REQUIRE(sweep.rounds()[1].size() == 3);
+
+	nti::ThresholdSweep above(0, 0.1f, 0.001f, 3, 0.8);
+	run(above);
+	REQUIRE(above.outcome() == nti::ThresholdSweep::Outcome::ABOVE_RANGE);
+	REQUIRE(above.rounds().size() == 1);
+	REQUIRE_THROWS(above.record({ 0.05f }, { 1 }, { 1 }));
+}
+
+TEST_CASE("Biased noise weighted by likelihood ratio estimates the nominal failure rate", "[stats]")
+{
+	const double p = nti::NTISeededNoise::EffectiveProbability(0.001f), q = nti::NTISeededNoise::EffectiveProbability(0.01f);
+	REQUIRE(nti::ImportanceStatistics::LogLikelihoodRatio(2, 100, p, q) == Approx(2 * std::log(p / q) + 98 * std::log((1 - p) / (1 - q))));
+	REQUIRE(std::isinf(nti::ImportanceStatistics::LogLikelihoodRatio(1, 100, 0, q)));
+
+	// a test fails when any of its 128 bits flips, which a 0.001 channel does to about 12% of them
+	nti::NTIChannelTester tester;
+	std::vector<nti::UserTestInput> inputs(4000, nti::UserTestInput{ "encode", 0.001f, "src" });
+	std::vector<std::string> encoded(inputs.size(), std::string(16, 'a'));
+	std::vector<nti::NoiseLikelihood> likelihoods;
+	auto noised = tester.generateBiasedInputs(inputs, encoded, 0.01f, 11, 0, likelihoods);
+	REQUIRE(likelihoods.size() == inputs.size());
+	REQUIRE(noised[0].noise_level == 0.001f); // the nominal level is kept
+	nti::ImportanceStatistics importance;
+	for (size_t i = 0; i < inputs.size(); ++i)
+		importance.add(0.001f, noised[i].input != encoded[i], likelihoods[i].log_ratio);
+	const auto &b = importance.overall();
+	REQUIRE(b.failures > 2000); // most tests fail under the bias
+	REQUIRE(std::abs(b.estimate() - (1 - std::pow(1 - p, 128))) < 4 * b.standardError());
+	REQUIRE(b.relativeError() < 0.1);
+}
+
+TEST_CASE("Running statistics merge and remove samples", "[stats]")
+{
+	std::vector<double> values = { 4, 7, 13, 16, 1.5, 0 };
+	nti::RunningStat all, left, right;
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		all.add(values[i]);
+		(i < 3 ? left : right).add(values[i]);
+	}
+	left.merge(right);
+	REQUIRE(left.count() == all.count());
+	REQUIRE(left.mean() == Approx(all.mean()));
+	REQUIRE(left.variance() == Approx(all.variance()));
+	REQUIRE(left.max() == 16);
+	all.remove(16);
+	all.remove(0);
+	REQUIRE(all.mean() == Approx(25.5 / 4));
+	REQUIRE(nti::TestStatistics::LengthBucket(1) == 0);
+	REQUIRE(nti::TestStatistics::LengthBucket(64) == 6);
+}
+
+TEST_CASE("Quantile sketches and distinct counts stay within their error bounds", "[stats]")
+{
+	nti::QuantileSketch left, right;
+	for (int i = 1; i <= 10000; ++i)
+		(i % 2 ? left : right).add(i);
+	left.merge(right);
+	REQUIRE(left.count() == 10000);
+	REQUIRE(left.quantile(0.5) == Approx(5000).epsilon(1.0 / 32));
+	REQUIRE(left.quantile(0.99) == Approx(9900).epsilon(1.0 / 32));
+	REQUIRE(left.quantile(1) == 10000);
+	nti::QuantileSketch small;
+	for (int i = 0; i < 10; ++i)
+		small.add(i);
+	REQUIRE(small.quantile(0.5) == 4); // exact below 32 units
+
+	nti::DistinctCounter distinct;
+	for (int i = 0; i < 20000; ++i)
+		distinct.add(nti::hash64(std::to_string(i % 10000)));
+	REQUIRE(distinct.estimate() == Approx(10000).epsilon(0.05));
+}
+
+TEST_CASE("Sequential estimator settles noise levels by their Wilson intervals", "[stats]")
+{
+	auto ci = nti::SequentialEstimator::WilsonInterval(8, 10, nti::SequentialEstimator::Z_95);
+	REQUIRE(ci.first == Approx(0.4902).epsilon(1e-3));
+	REQUIRE(ci.second == Approx(0.9433).epsilon(1e-3));
+	REQUIRE(nti::SequentialEstimator::WilsonInterval(0, 0, 2).second == 1);
+
+	nti::SequentialEstimator est({ 0.f, 0.1f, 0.2f }, 0.8, 0.05, 400);
+	for (int i = 0; i < 400; ++i)
+	{
+		for (auto level : est.open())
+			est.add(level, level == 0.f || (level == 0.1f && i % 10 < 8));
+		est.decide();
+		if (est.open().empty())
+			break;
+	}
+	using V = nti::SequentialEstimator::Verdict;
+	REQUIRE(est.levels()[0].verdict == V::ABOVE);
+	REQUIRE(est.levels()[0].tests < 30); // all passing clears the threshold quickly
+	REQUIRE(est.levels()[1].verdict == V::EXHAUSTED); // right at the threshold it never does
+	REQUIRE(est.levels()[1].tests == 400);
+	REQUIRE(est.levels()[2].verdict == V::BELOW);
+	REQUIRE(est.levels()[2].tests < 10);
+	REQUIRE(est.open().empty());
+	REQUIRE_THROWS(est.add(0.3f, true));
+
+	// a round is counted whole before any level of it is settled
+	nti::SequentialEstimator round({ 0.f }, 0.8, 0.05, 400);
+	for (int i = 0; i < 50; ++i)
+		round.add(0.f, true);
+	REQUIRE(round.levels()[0].verdict == V::OPEN);
+	round.decide();
+	REQUIRE(round.levels()[0].verdict == V::ABOVE);
+	REQUIRE(round.levels()[0].low == Approx(nti::SequentialEstimator::WilsonInterval(50, 50, nti::SequentialEstimator::Z_95).first));
+	REQUIRE_THROWS(round.add(0.f, true)); // a settled level takes no more tests, its interval stays as decided
+}
+
 #endif
\ No newline at end of file
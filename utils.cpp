@@ -1,15 +1,39 @@
 #include "utils.h"
 #include <random>
 #include <array>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
 
 std::vector<std::string> split(const std::string& s, const std::string &delimeter) {
 	std::vector<std::string> ret;
-	size_t i = 0, ds = delimeter.size();
-	while (i != s.npos) {
-		size_t inext = s.find(delimeter, i); // find the beginning of a word
-		if (i != s.npos)
-			ret.push_back(s.substr(i, inext-i)); //insert the word into vector
-		i = inext!=s.npos ? s.find_first_not_of(delimeter, inext+ds) : inext;
+	for (const auto &r : split_ranges(s.data(), s.size(), delimeter))
+		ret.push_back(s.substr(r.first, r.second - r.first)); //insert the word into vector
+	return ret;
+}
+
+std::vector<std::pair<size_t, size_t>> split_ranges(const char* s, size_t size, const std::string& delimeter)
+{
+	std::vector<std::pair<size_t, size_t>> ret;
+	const size_t ds = delimeter.size();
+	size_t i = 0;
+	while (true) {
+		// find the beginning of a delimeter
+		const char *p = s + i, *end = s + size;
+		while ((p = static_cast<const char*>(memchr(p, delimeter[0], end - p))) != nullptr && 
+			   (size_t(end - p) < ds || memcmp(p, delimeter.data(), ds) != 0))
+			++p;
+		size_t inext = p ? p - s : size;
+		ret.emplace_back(i, inext);
+		if (p == nullptr)
+			break;
+		// skip every delimeter char, just like find_first_not_of does
+		for (i = inext + ds; i < size && delimeter.find(s[i]) != delimeter.npos; ++i);
+		if (i >= size)
+			break;
 	}
 	return ret;
 }
@@ -54,3 +78,124 @@ std::string generate_alnum_str(size_t len)
 	std::generate_n(source.begin(), len, [&rng, &determine_char]() { return determine_char(text_d(rng)); });
 	return source;
 }
+
+size_t parallel_shards(size_t count)
+{
+	size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+	return std::max<size_t>(1, std::min(threads, count));
+}
+
+namespace
+{
+	// Workers started once and kept for the life of the process; parallel_for hands them the shards of a job
+	// instead of starting threads for every batch. One job runs on them at a time.
+	class WorkerPool
+	{
+		std::vector<std::thread> threads_;
+		std::mutex mutex_;
+		std::condition_variable start_, done_;
+		const std::function<void(size_t)> *task_ = { nullptr };
+		size_t next_ = { 0 }, count_ = { 0 }, running_ = { 0 };
+		bool stop_ = { false };
+		std::atomic<bool> busy_ = { false };
+
+		WorkerPool(size_t workers)
+		{
+			for (size_t i = 0; i < workers; ++i)
+				threads_.emplace_back(&WorkerPool::work_, this);
+		}
+
+		void work_()
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			while (true)
+			{
+				start_.wait(lock, [this]() { return stop_ || (task_ && next_ < count_); });
+				if (stop_)
+					return;
+				auto shard = next_++;
+				++running_;
+				auto task = task_;
+				lock.unlock();
+				(*task)(shard);
+				lock.lock();
+				if (--running_ == 0 && next_ == count_)
+					done_.notify_all();
+			}
+		}
+	public:
+		~WorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
+			}
+			start_.notify_all();
+			for (auto &t : threads_)
+				t.join();
+		}
+
+		static WorkerPool &Instance()
+		{
+			static WorkerPool pool(std::max<size_t>(1, std::thread::hardware_concurrency()) - 1);
+			return pool;
+		}
+
+		// runs task(0) .. task(count - 1), the calling thread takes shards too; false if another job holds the workers
+		bool run(size_t count, const std::function<void(size_t)> &task)
+		{
+			bool idle = false;
+			if (threads_.empty() || !busy_.compare_exchange_strong(idle, true))
+				return false;
+			std::unique_lock<std::mutex> lock(mutex_);
+			task_ = &task;
+			next_ = 0;
+			count_ = count;
+			start_.notify_all();
+			while (next_ < count_)
+			{
+				auto shard = next_++;
+				++running_;
+				lock.unlock();
+				task(shard);
+				lock.lock();
+				--running_;
+			}
+			done_.wait(lock, [this]() { return running_ == 0; });
+			task_ = nullptr;
+			lock.unlock();
+			busy_ = false;
+			return true;
+		}
+	};
+}
+
+void parallel_for(size_t count, const std::function<void(size_t, size_t, size_t)> &fn)
+{
+	size_t shards = parallel_shards(count);
+	std::vector<std::exception_ptr> errors(shards);
+	std::function<void(size_t)> run = [&](size_t shard)
+	{
+		try
+		{
+			fn(shard, count * shard / shards, count * (shard + 1) / shards);
+		}
+		catch (...)
+		{
+			errors[shard] = std::current_exception();
+		}
+	};
+	// a nested or concurrent job, or a single shard, starts threads of its own
+	if (shards == 1 || !WorkerPool::Instance().run(shards, run))
+	{
+		std::vector<std::thread> threads;
+		for (size_t shard = 1; shard < shards; ++shard)
+			threads.emplace_back(run, shard);
+		run(0); // the calling thread takes the first shard
+		for (auto &t : threads)
+			t.join();
+	}
+	for (auto &e : errors)
+		if (e)
+			std::rethrow_exception(e);
+}
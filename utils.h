@@ -3,6 +3,8 @@
 #include <vector>
 #include <algorithm>
 #include <cassert>
+#include <stdexcept>
+#include <functional>
 
 #ifdef _WIN32
 #define NEWLINE "\r\n"
@@ -15,5 +17,14 @@
 
 std::vector<std::string> split(const std::string& s, const std::string &delimeter);
 
+// same tokens as 'split', but as [begin, end) ranges into 's' - nothing is copied
+std::vector<std::pair<size_t, size_t>> split_ranges(const char *s, size_t size, const std::string &delimeter);
 
-std::string generate_alnum_str(size_t len);
\ No newline at end of file
+
+std::string generate_alnum_str(size_t len);
+
+// number of shards 'parallel_for' splits 'count' items into
+size_t parallel_shards(size_t count);
+// runs fn(shard, begin, end) over contiguous shards of [0, count) on all hardware threads, kept as workers between
+// calls; rethrows the first exception
+void parallel_for(size_t count, const std::function<void(size_t, size_t, size_t)> &fn);
\ No newline at end of file